@@ -0,0 +1,90 @@
+/*
+ * Búsquedas que casi siempre fallan (como en la deduplicación): findbtree
+ * solo contra blfindbtree, que mira el filtro de Bloom antes del árbol.
+ * Mitad de las claves se insertan, se busca con una proporción de aciertos
+ * dada; también cuánto cuesta insertar manteniendo el filtro.
+ *
+ * Compilar: cc -O2 bench/bloom.c -o bench_bloom -pthread -lm
+ * Uso:      ./bench_bloom [cantidad de claves] [% aciertos] [falsos positivos]
+ */
+
+#include "../bloom/bloom.h"
+#include <time.h>
+
+typedef unsigned long type;
+
+static type __state = 88172645463325252UL;
+
+// xorshift64, para que las corridas sean reproducibles
+static inline type xorshift(void) {
+  __state ^= __state << 13;
+  __state ^= __state >> 7;
+  __state ^= __state << 17;
+  return __state;
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const double hit = argc > 2 ? atof(argv[2]) / 100 : 0.05;
+  const double fpr = argc > 3 ? atof(argv[3]) : 0.01;
+  if (0 == n)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  // Las pares van al árbol, las impares no están
+  type *keys = (type *)malloc(n * sizeof(type)),
+       *probes = (type *)malloc(n * sizeof(type));
+  if (nullptr == keys || nullptr == probes)
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < n; ++i)
+    keys[i] = xorshift() & ~1UL;
+  for (size_t i = 0; i < n; ++i)
+    probes[i] = xorshift() % 1000 < hit * 1000 ? keys[xorshift() % n]
+                                               : xorshift() | 1;
+
+  btreeptr_t plain = nullptr, filtered = nullptr, ret;
+  bloomptr_t bloom;
+  if (initbloom(&bloom, sizeof(type), 0, fpr))
+    return EXIT_FAILURE;
+
+  double t = now();
+  for (size_t i = 0; i < n; ++i)
+    insbtree(&plain, keys + i, sizeof(type));
+  double ins = now() - t;
+
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    blinsbtree(bloom, &filtered, keys + i);
+  double blins = now() - t;
+
+  size_t hits = 0, blhits = 0;
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    hits += EXIT_SUCCESS == findbtree(plain, probes + i, sizeof(type), &ret);
+  double find = now() - t;
+
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    blhits += EXIT_SUCCESS == blfindbtree(bloom, filtered, probes + i, &ret);
+  double blfind = now() - t;
+
+  printf("keys: %zu  hits: %.1f%%  fpr: %g (%zu bytes of filter)\n", n,
+         100.0 * hits / n, fpr, bloom->blocks * 64);
+  printf("%-12s %12s %12s\n", "", "insert ns", "find ns");
+  printf("%-12s %12.1f %12.1f\n", "btree", ins / n, find / n);
+  printf("%-12s %12.1f %12.1f\n", "bloom+btree", blins / n, blfind / n);
+  if (hits != blhits)
+    printf("MISMATCH: %zu vs %zu hits\n", hits, blhits);
+
+  freebtree(&plain);
+  freebtree(&filtered);
+  freebloom(&bloom);
+  free(keys);
+  free(probes);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/*
+ * Compara btree_t (insbtree/findbtree) contra el B+-tree de bptree/:
+ * latencia de búsqueda y memoria por clave, con claves aleatorias de 8 bytes.
+ *
+ * Compilar: cc -O2 bench/bptree.c -o bench_bptree
+ * Uso:      ./bench_bptree [cantidad de claves]
+ */
+
+#include "../btree/btree.h"
+#include "../bptree/bptree.h"
+#include <malloc.h>
+#include <time.h>
+
+typedef unsigned long type;
+
+static type __state = 88172645463325252UL;
+
+// xorshift64, para que las corridas sean reproducibles
+static inline type xorshift(void) {
+  __state ^= __state << 13;
+  __state ^= __state >> 7;
+  __state ^= __state << 17;
+  return __state;
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static inline size_t heap(void) { return mallinfo2().uordblks; }
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  if (0 == n)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  type *keys = (type *)malloc(n * sizeof(type));
+  type *probes = (type *)malloc(n * sizeof(type));
+  if (nullptr == keys || nullptr == probes)
+    return EXIT_FAILURE;
+
+  for (size_t i = 0; i < n; ++i)
+    keys[i] = xorshift();
+  // Se busca en otro orden que el de inserción
+  for (size_t i = 0; i < n; ++i)
+    probes[i] = keys[xorshift() % n];
+
+  btreeptr_t root = nullptr, ret;
+  bptreeptr_t tree;
+  void *found;
+  size_t hits = 0, before;
+  double t;
+
+  printf("keys: %zu\n", n);
+  printf("%-8s %12s %12s %12s\n", "tree", "ins ns/op", "find ns/op",
+         "bytes/key");
+
+  before = heap();
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    insbtree(&root, keys + i, sizeof(type));
+  double ins = (now() - t) / n;
+  double mem = (double)(heap() - before) / n;
+
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    hits += EXIT_SUCCESS == findbtree(root, probes + i, sizeof(type), &ret);
+  printf("%-8s %12.1f %12.1f %12.1f\n", "btree", ins, (now() - t) / n, mem);
+  freebtree(&root);
+
+  before = heap();
+  if (initbptree(&tree, sizeof(type), nullptr))
+    return EXIT_FAILURE;
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    insbptree(tree, keys + i);
+  ins = (now() - t) / n;
+  mem = (double)(heap() - before) / n;
+
+  t = now();
+  for (size_t i = 0; i < n; ++i)
+    hits += EXIT_SUCCESS == findbptree(tree, probes + i, &found);
+  printf("%-8s %12.1f %12.1f %12.1f\n", "bptree", ins, (now() - t) / n, mem);
+  freebptree(&tree);
+
+  if (hits != 2 * n)
+    printf("MISSING KEYS: %zu of %zu\n", 2 * n - hits, 2 * n);
+
+  free(keys);
+  free(probes);
+  return EXIT_SUCCESS;
+}
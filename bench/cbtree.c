@@ -0,0 +1,247 @@
+/*
+ * Escalabilidad del árbol concurrente de cbtree/ contra btree_t con un mutex
+ * global, de 1 a N hilos. Dos cargas: solo búsquedas, y mixta (90% búsquedas,
+ * 10% inserciones de claves nuevas). Imprime millones de operaciones por
+ * segundo (sumando todos los hilos).
+ *
+ * Con "stress" como primer argumento no mide: hilos lectores buscan claves
+ * que nunca se borran mientras otro hilo llama a cfrehashbtree sin parar y
+ * otro inserta y borra. Cualquier búsqueda fallida es un error; conviene
+ * compilarlo con -fsanitize=address o thread.
+ *
+ * Compilar: cc -O2 -pthread bench/cbtree.c -o bench_cbtree
+ * Uso:      ./bench_cbtree [cantidad de claves] [hilos máx] [ops por hilo]
+ *           ./bench_cbtree stress [cantidad de claves] [lectores] [segundos]
+ */
+
+#include "../btree/btree.h"
+#include "../cbtree/cbtree.h"
+#include <time.h>
+#include <unistd.h>
+
+typedef unsigned long type;
+
+// xorshift64, un estado por hilo para que las corridas sean reproducibles
+static inline type xorshift(type *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct {
+  cbtreeptr_t tree;      // Si es nullptr se usa root con el mutex
+  btreeptr_t *root;
+  pthread_mutex_t *lock;
+  const type *keys;
+  size_t n, ops;
+  int mixed;
+  type state;
+  size_t hits;
+} job_t;
+
+static void *work(void *arg) {
+  job_t *job = (job_t *)arg;
+  btreeptr_t ret;
+  type key;
+
+  for (size_t i = 0; i < job->ops; ++i) {
+    type r = xorshift(&job->state);
+    if (job->mixed && 0 == r % 10) {
+      key = r; // Clave nueva (casi siempre)
+      if (job->tree)
+        cinsbtree(job->tree, &key);
+      else {
+        pthread_mutex_lock(job->lock);
+        insbtree(job->root, &key, sizeof(type));
+        pthread_mutex_unlock(job->lock);
+      }
+      continue;
+    }
+
+    key = job->keys[r % job->n];
+    if (job->tree)
+      job->hits += EXIT_SUCCESS == cfindbtree(job->tree, &key, nullptr);
+    else {
+      pthread_mutex_lock(job->lock);
+      job->hits += EXIT_SUCCESS == findbtree(*job->root, &key, sizeof(type),
+                                             &ret);
+      pthread_mutex_unlock(job->lock);
+    }
+  }
+  return nullptr;
+}
+
+// Millones de operaciones por segundo con threads hilos
+static double run(job_t *base, const size_t threads) {
+  pthread_t ids[threads];
+  job_t jobs[threads];
+
+  double t = now();
+  for (size_t i = 0; i < threads; ++i) {
+    jobs[i] = *base;
+    jobs[i].state = 88172645463325252UL + 7919 * i;
+    if (pthread_create(ids + i, nullptr, work, jobs + i))
+      return 0;
+  }
+  for (size_t i = 0; i < threads; ++i)
+    pthread_join(ids[i], nullptr);
+
+  return 1e3 * threads * base->ops / (now() - t);
+}
+
+typedef struct {
+  cbtreeptr_t tree;
+  const type *keys;
+  size_t n;
+  int stop;
+  type state;
+  size_t ops, lost;
+} stress_t;
+
+static void *stress_read(void *arg) {
+  stress_t *job = (stress_t *)arg;
+  type key;
+
+  while (!__atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+    key = job->keys[xorshift(&job->state) % job->n];
+    job->lost += EXIT_SUCCESS != cfindbtree(job->tree, &key, nullptr);
+    ++job->ops;
+  }
+  return nullptr;
+}
+
+// Claves impares, las de keys son todas pares
+static void *stress_write(void *arg) {
+  stress_t *job = (stress_t *)arg;
+  type key;
+
+  while (!__atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+    key = xorshift(&job->state) | 1;
+    cinsbtree(job->tree, &key);
+    cdelbtree(job->tree, &key);
+    ++job->ops;
+  }
+  return nullptr;
+}
+
+static void *stress_rehash(void *arg) {
+  stress_t *job = (stress_t *)arg;
+
+  while (!__atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+    cfrehashbtree(job->tree);
+    ++job->ops;
+  }
+  return nullptr;
+}
+
+static int stress(int argc, char *argv[]) {
+  size_t n = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000;
+  size_t readers = argc > 3 ? strtoul(argv[3], nullptr, 10) : 4;
+  unsigned seconds = argc > 4 ? strtoul(argv[4], nullptr, 10) : 5;
+  if (0 == n || 0 == readers)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  type *keys = (type *)malloc(n * sizeof(type)), state = 2463534242UL;
+  cbtreeptr_t tree = nullptr;
+  if (nullptr == keys || initcbtree(&tree, sizeof(type), nullptr))
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = xorshift(&state) & ~1UL;
+    cinsbtree(tree, keys + i);
+  }
+
+  pthread_t ids[readers + 2];
+  stress_t jobs[readers + 2];
+  for (size_t i = 0; i < readers + 2; ++i) {
+    jobs[i] = (stress_t){tree, keys, n, 0, 88172645463325252UL + 7919 * i, 0,
+                         0};
+    void *(*fn)(void *) = i < readers    ? stress_read
+                          : i == readers ? stress_write
+                                         : stress_rehash;
+    if (pthread_create(ids + i, nullptr, fn, jobs + i))
+      return EXIT_FAILURE;
+  }
+
+  sleep(seconds);
+  size_t reads = 0, lost = 0;
+  for (size_t i = 0; i < readers + 2; ++i)
+    __atomic_store_n(&jobs[i].stop, 1, __ATOMIC_RELAXED);
+  for (size_t i = 0; i < readers + 2; ++i) {
+    pthread_join(ids[i], nullptr);
+    if (i < readers) {
+      reads += jobs[i].ops;
+      lost += jobs[i].lost;
+    }
+  }
+
+  printf("reads: %zu  writes: %zu  rehashes: %zu  lost: %zu\n", reads,
+         jobs[readers].ops, jobs[readers + 1].ops, lost);
+  freecbtree(&tree);
+  free(keys);
+  return lost ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && 0 == strcmp(argv[1], "stress"))
+    return stress(argc, argv);
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t maxthreads = argc > 2 ? strtoul(argv[2], nullptr, 10)
+                               : (size_t)(cores > 0 ? cores : 1);
+  size_t ops = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1000000;
+  if (0 == n || 0 == maxthreads || 0 == ops)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  type *keys = (type *)malloc(n * sizeof(type)), state = 2463534242UL;
+  if (nullptr == keys)
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < n; ++i)
+    keys[i] = xorshift(&state);
+
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  printf("keys: %zu  ops/thread: %zu  cores: %ld\n", n, ops, cores);
+  printf("%-8s %12s %12s %12s %12s\n", "threads", "cb read", "cb mixed",
+         "mtx read", "mtx mixed");
+
+  for (size_t threads = 1; threads <= maxthreads; ++threads) {
+    double res[4];
+
+    // Cada medición arranca con las mismas claves, rebalanceado
+    for (int mode = 0; mode < 4; ++mode) {
+      cbtreeptr_t tree = nullptr;
+      btreeptr_t root = nullptr;
+
+      if (mode < 2) {
+        if (initcbtree(&tree, sizeof(type), nullptr))
+          return EXIT_FAILURE;
+        for (size_t i = 0; i < n; ++i)
+          cinsbtree(tree, keys + i);
+        cfrehashbtree(tree);
+      } else {
+        for (size_t i = 0; i < n; ++i)
+          insbtree(&root, keys + i, sizeof(type));
+        ifrehashbtree(&root);
+      }
+
+      job_t job = {tree, &root, &lock, keys, n, ops, mode & 1, 0, 0};
+      res[mode] = run(&job, threads);
+
+      freecbtree(&tree);
+      freebtree(&root);
+    }
+
+    printf("%-8zu %12.2f %12.2f %12.2f %12.2f\n", threads, res[0], res[1],
+           res[2], res[3]);
+  }
+
+  free(keys);
+  return EXIT_SUCCESS;
+}
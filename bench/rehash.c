@@ -0,0 +1,81 @@
+/*
+ * Compara frehashbtree (arreglo de nodos + reconstrucción) contra
+ * ifrehashbtree (rotaciones en el lugar): tiempo y pico de RSS extra.
+ * Cada modo corre en un proceso hijo, así el pico de uno no tapa al otro.
+ *
+ * Compilar: cc -O2 bench/rehash.c -o bench_rehash
+ * Uso:      ./bench_rehash [cantidad de claves]
+ */
+
+#include "../btree/btree.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef unsigned long type;
+
+static type __state = 88172645463325252UL;
+
+static inline type xorshift(void) {
+  __state ^= __state << 13;
+  __state ^= __state >> 7;
+  __state ^= __state << 17;
+  return __state;
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// En KiB
+static inline long peakrss(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+static int comp(const void *a, const void *b) { return memcmp(a, b, 8); }
+
+static int run(const char *name, size_t n, int inplace) {
+  btreeptr_t root = nullptr;
+  type key;
+
+  for (size_t i = 0; i < n; ++i) {
+    key = xorshift();
+    insbtree(&root, &key, sizeof(type));
+  }
+
+  long before = peakrss();
+  double t = now();
+  err_t err = inplace ? ifrehashbtree(&root) : frehashbtree(&root, comp);
+  t = now() - t;
+
+  printf("%-8s %12.1f %12.2f %14ld\n", name, t / 1e6, t / n, peakrss() - before);
+  return err;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const char *names[] = {"array", "inplace"};
+  int status;
+
+  printf("keys: %zu\n", n);
+  printf("%-8s %12s %12s %14s\n", "rehash", "ms", "ns/node", "peak +KiB");
+  fflush(stdout);
+
+  for (int i = 0; i < 2; ++i) {
+    pid_t pid = fork();
+    if (-1 == pid)
+      return EXIT_FAILURE;
+    if (0 == pid)
+      return run(names[i], n, i);
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+      printf("%s FAILED\n", names[i]);
+  }
+
+  return EXIT_SUCCESS;
+}
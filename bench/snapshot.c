@@ -0,0 +1,113 @@
+/*
+ * Arranque en frío: volver a tener un árbol consultable desde disco.
+ * Compara releer las claves y repetir insbtree (lo que se hacía antes)
+ * contra openfbtree sobre un archivo de writebtree, más las primeras
+ * búsquedas, que son las que traen páginas del disco.
+ *
+ * Para medir de verdad en frío hay que vaciar la caché de páginas entre
+ * las dos etapas (como root: echo 3 > /proc/sys/vm/drop_caches); el
+ * programa espera un Enter antes de abrir si se le pasa un tercer argumento.
+ *
+ * Compilar: cc -O2 bench/snapshot.c -o bench_snapshot
+ * Uso:      ./bench_snapshot [cantidad de claves] [directorio] [pausa]
+ */
+
+#include "../fbtree/fbtree.h"
+#include <time.h>
+
+typedef unsigned long type;
+
+static type __state = 88172645463325252UL;
+
+// xorshift64, para que las corridas sean reproducibles
+static inline type xorshift(void) {
+  __state ^= __state << 13;
+  __state ^= __state >> 7;
+  __state ^= __state << 17;
+  return __state;
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Orden numérico, como lo esperan las funciones _u64
+static long numcmp(const void *a, const void *b, size_t size) {
+  (void)size;
+  return (*(const type *)a > *(const type *)b) -
+         (*(const type *)a < *(const type *)b);
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const char *dir = argc > 2 ? argv[2] : ".";
+  char raw[4096], snap[4096];
+  if (0 == n)
+    return EXIT_FAILURE_IMPROPER_USE;
+  snprintf(raw, sizeof(raw), "%s/bench_snapshot.raw", dir);
+  snprintf(snap, sizeof(snap), "%s/bench_snapshot.fb", dir);
+
+  type *keys = (type *)malloc(n * sizeof(type));
+  if (nullptr == keys)
+    return EXIT_FAILURE;
+  for (size_t i = 0; i < n; ++i)
+    keys[i] = xorshift();
+
+  // Las dos formas de guardar
+  btreeptr_t root = nullptr, ret;
+  for (size_t i = 0; i < n; ++i)
+    finsbtree(&root, keys + i, sizeof(type), numcmp);
+  FILE *file = fopen(raw, "wb");
+  if (nullptr == file || n != fwrite(keys, sizeof(type), n, file) ||
+      fclose(file) || writebtree(root, sizeof(type), snap))
+    return EXIT_FAILURE;
+  freebtree(&root);
+
+  if (argc > 3) {
+    printf("archivos escritos en %s, Enter para seguir\n", dir);
+    getchar();
+  }
+
+  const size_t probes = n < 1000 ? n : 1000;
+  size_t hits = 0;
+  void *found;
+  double t = now();
+
+  fbtreeptr_t fb;
+  if (openfbtree(&fb, snap))
+    return EXIT_FAILURE;
+  double open = now() - t;
+  for (size_t i = 0; i < probes; ++i)
+    hits += EXIT_SUCCESS == findfbtree_u64(fb, keys[i * (n / probes)], &found);
+  double fbtotal = now() - t;
+  freefbtree(&fb);
+
+  t = now();
+  file = fopen(raw, "rb");
+  type key;
+  while (file && 1 == fread(&key, sizeof(type), 1, file))
+    finsbtree(&root, &key, sizeof(type), numcmp);
+  if (file)
+    fclose(file);
+  double replay = now() - t;
+  for (size_t i = 0; i < probes; ++i)
+    hits += EXIT_SUCCESS ==
+            ffindbtree(root, keys + i * (n / probes), sizeof(type), &ret,
+                       numcmp);
+  double btotal = now() - t;
+  freebtree(&root);
+
+  printf("keys: %zu  probes: %zu\n", n, probes);
+  printf("%-8s %14s %14s\n", "start", "ready ms", "+probes ms");
+  printf("%-8s %14.3f %14.3f\n", "mmap", open / 1e6, fbtotal / 1e6);
+  printf("%-8s %14.3f %14.3f\n", "replay", replay / 1e6, btotal / 1e6);
+  if (hits != 2 * probes)
+    printf("MISSING KEYS: %zu of %zu\n", 2 * probes - hits, 2 * probes);
+
+  remove(raw);
+  remove(snap);
+  free(keys);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+/*
+ * Registros por segundo del registro de estados de dcl/ con cada política
+ * de fsync, con estados de unos 40 bytes.
+ *
+ * Compilar: cc -O2 -msse4.2 bench/statuslog.c -o bench_statuslog -pthread
+ * Uso:      ./bench_statuslog [cantidad de estados] [archivo]
+ */
+
+#include "../dcl/func.c"
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+  const char *path = argc > 2 ? argv[2] : "bench_statuslog.log";
+  if (0 == n)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  struct {
+    const char *name;
+    int policy;
+    uint64_t every;
+    size_t n; // STATUS_SYNC_CALL es lento, se mide con menos
+  } runs[] = {{"none", STATUS_SYNC_NONE, 0, n},
+              {"4096", STATUS_SYNC_COUNT, 4096, n},
+              {"10ms", STATUS_SYNC_TIME, 10, n},
+              {"call", STATUS_SYNC_CALL, 0, n / 1000 ? n / 1000 : 1}};
+
+  printf("%-8s %12s %12s\n", "sync", "records", "records/s");
+  for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+    statuslog_t log;
+    char text[64];
+
+    unlink(path);
+    if (openstatus(&log, path, runs[r].policy, runs[r].every))
+      return EXIT_FAILURE;
+
+    double t = now();
+    for (size_t i = 0; i < runs[r].n; ++i) {
+      int len = snprintf(text, sizeof(text), "job %zu state=running node=%zu",
+                         i, i % 97);
+      if (appendstatus(&log, text, len))
+        return EXIT_FAILURE;
+    }
+    if (closestatus(&log))
+      return EXIT_FAILURE;
+    t = now() - t;
+
+    printf("%-8s %12zu %12.0f\n", runs[r].name, runs[r].n, runs[r].n / t * 1e9);
+  }
+
+  unlink(path);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,323 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef BTREE_H
+#include "../btree/btree.h"
+#endif
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Filtro de Bloom delante de un btree_t:
+ * Casi todas las búsquedas de claves que no están recorren el árbol entero
+ * comparando en cada nivel. El filtro responde "seguro que no está" con una
+ * sola línea de caché: está partido en bloques de 64 bytes y los k bits de
+ * cada clave caen todos en el mismo bloque (el hash elige el bloque y, de lo
+ * que sobra, los k bits). Si dice "puede estar" se busca en el árbol.
+ *
+ * Solo se hashean los primeros size bytes de cada dato: con ffindbtree y
+ * compañía, cmp(a, b) == 0 tiene que implicar esos bytes iguales.
+ *
+ * No se puede borrar de un filtro de Bloom: después de delbtree las claves
+ * borradas siguen dando "puede estar" hasta rehashbloom(...). frehashbtree
+ * no cambia las claves, el filtro sigue sirviendo tal cual.
+ */
+
+typedef struct bloom bloom_t;
+typedef struct bloom *bloomptr_t;
+
+struct bloom {
+  uint64_t *bits; // blocks * BLOOM_WORDS
+  size_t blocks;
+  size_t size; // Bytes hasheados de cada dato
+  size_t cap;  // Claves para las que se dimensionó
+  size_t len;  // Claves agregadas (con repetidas)
+  double fpr;  // Falsos positivos buscados con cap claves
+  unsigned k;  // Bits por clave
+};
+
+#define BLOOM_WORDS 8 // Un bloque = 64 bytes = 512 bits
+
+#ifndef BLOOM_MIN_CAP
+#define BLOOM_MIN_CAP 64
+#endif
+
+// Mezcla de 8 en 8 bytes con producto de 128 bits (tipo wyhash)
+static inline uint64_t __bloommix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static inline uint64_t __bloomhash(const void *data, size_t size) {
+  const char *p = (const char *)data;
+  uint64_t h = 0xa0761d6478bd642fULL ^ size, w;
+
+  for (; size >= 8; size -= 8, p += 8) {
+    memcpy(&w, p, 8);
+    h = __bloommix(h ^ w, 0xe7037ed1a0b428dbULL);
+  }
+  if (size) {
+    w = 0;
+    memcpy(&w, p, size);
+    h = __bloommix(h ^ w, 0xe7037ed1a0b428dbULL);
+  }
+  return __bloommix(h, 0x8ebc6af09c88c6e3ULL);
+}
+
+// Los 32 bits altos eligen el bloque (sin módulo)
+static inline uint64_t *__bloomblock(bloomptr_t b, const uint64_t hash) {
+  return b->bits + BLOOM_WORDS * ((hash >> 32) * b->blocks >> 32);
+}
+
+// Bit i de la clave dentro del bloque: de 9 en 9 bits de un segundo hash
+#define BLOOM_BIT(h, i) (((h) >> (9 * ((i) % 7))) & 511)
+#define BLOOM_NEXT(h, i)                                                       \
+  ((i) && 0 == (i) % 7 ? __bloommix((h), 0x1d8e4e27c47d124fULL) : (h))
+
+/*
+ * Bits por clave para fpr, como un Bloom común (-ln fpr / ln²2) más un
+ * poco porque los bloques no se llenan parejo.
+ */
+static err_t __allocbloom(bloomptr_t b, size_t cap) {
+  const double per = -log(b->fpr) / (M_LN2 * M_LN2) * 1.15;
+  size_t blocks = (size_t)ceil(per * (double)cap / 512.0);
+  uint64_t *bits;
+
+  if (blocks > UINT32_MAX)
+    return EXIT_FAILURE;
+  if (0 == blocks)
+    blocks = 1;
+  bits = (uint64_t *)aligned_alloc(64, blocks * 64);
+  if (nullptr == bits)
+    return EXIT_FAILURE;
+
+  memset(bits, 0, blocks * 64);
+  free(b->bits);
+  b->bits = bits;
+  b->blocks = blocks;
+  b->cap = cap;
+  b->len = 0;
+  return EXIT_SUCCESS;
+}
+
+// hint es la cantidad de claves esperada (puede ser 0), fpr en (0, 1)
+err_t initbloom(bloomptr_t *const b, const size_t size, const size_t hint,
+                const double fpr) {
+  if (nullptr == b || 0 == size || !(fpr > 0.0 && fpr < 1.0))
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *b = (bloomptr_t)calloc(1, sizeof(bloom_t));
+  if (nullptr == *b)
+    return EXIT_FAILURE;
+
+  (*b)->size = size;
+  (*b)->fpr = fpr;
+  (*b)->k = (unsigned)lround(-log(fpr) / M_LN2);
+  if ((*b)->k < 1)
+    (*b)->k = 1;
+  if ((*b)->k > 16)
+    (*b)->k = 16;
+
+  if (EXIT_SUCCESS !=
+      __allocbloom(*b, hint > BLOOM_MIN_CAP ? hint : BLOOM_MIN_CAP)) {
+    free(*b);
+    *b = nullptr;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+static inline void __insbloom(bloomptr_t b, const void *data) {
+  const uint64_t hash = __bloomhash(data, b->size);
+  uint64_t *block = __bloomblock(b, hash),
+           h = __bloommix(hash, 0x589965cc75374cc3ULL);
+
+  for (unsigned i = 0, bit; i < b->k; ++i) {
+    h = BLOOM_NEXT(h, i);
+    bit = BLOOM_BIT(h, i);
+    block[bit >> 6] |= 1ULL << (bit & 63);
+  }
+  ++b->len;
+}
+
+err_t insbloom(bloomptr_t b, const void *data) {
+  if (nullptr == b || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __insbloom(b, data);
+  return EXIT_SUCCESS;
+}
+
+// EXIT_SUCCESS si data puede estar, EXIT_FAILURE_NOT_FOUND si seguro no
+err_t findbloom(bloomptr_t b, const void *data) {
+  if (nullptr == b || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  const uint64_t hash = __bloomhash(data, b->size);
+  const uint64_t *block = __bloomblock(b, hash);
+  uint64_t h = __bloommix(hash, 0x589965cc75374cc3ULL);
+
+  for (unsigned i = 0, bit; i < b->k; ++i) {
+    h = BLOOM_NEXT(h, i);
+    bit = BLOOM_BIT(h, i);
+    if (!(block[bit >> 6] & (1ULL << (bit & 63))))
+      return EXIT_FAILURE_NOT_FOUND;
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Vacía el filtro y lo llena con las claves de root. Si el cursor se queda
+ * sin memoria a la mitad, el filtro diría "no está" de claves que sí: se
+ * llena de unos (todo "puede estar", las búsquedas van al árbol) y se
+ * retorna EXIT_FAILURE.
+ */
+static err_t __fillbloom(bloomptr_t b, btreeptr_t root) {
+  btcursor_t it;
+  err_t e;
+
+  memset(b->bits, 0, b->blocks * 64);
+  b->len = 0;
+  for (e = beginbtree(&it, root); !e; e = nextbtree(&it))
+    __insbloom(b, it.node->data);
+
+  if (EXIT_FAILURE_NOT_FOUND == e)
+    return EXIT_SUCCESS;
+  memset(b->bits, 0xff, b->blocks * 64);
+  return EXIT_FAILURE;
+}
+
+/*
+ * Vuelve a llenar el filtro con las claves de root (recorrido in-order).
+ * Si el árbol tiene más claves que cap, se agranda al doble de las que
+ * tiene.
+ */
+err_t rehashbloom(bloomptr_t b, btreeptr_t root) {
+  if (nullptr == b)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (EXIT_SUCCESS != __fillbloom(b, root))
+    return EXIT_FAILURE;
+  if (b->len <= b->cap)
+    return EXIT_SUCCESS;
+
+  if (EXIT_SUCCESS != __allocbloom(b, 2 * b->len))
+    return EXIT_FAILURE;
+  return __fillbloom(b, root);
+}
+
+// Agrega nmemb datos contiguos de stride bytes (como los de initarrbtree)
+err_t arrbloom(bloomptr_t b, const void *data, const size_t nmemb,
+               const size_t stride) {
+  if (nullptr == b || (nullptr == data && nmemb) || stride < b->size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (b->len + nmemb > b->cap) {
+    // Lo que ya tenía no se puede sacar del filtro viejo
+    if (b->len)
+      return EXIT_FAILURE_IMPROPER_USE;
+    if (EXIT_SUCCESS != __allocbloom(b, nmemb))
+      return EXIT_FAILURE;
+  }
+
+  const char *p = (const char *)data;
+  for (size_t i = 0; i < nmemb; ++i, p += stride)
+    __insbloom(b, p);
+  return EXIT_SUCCESS;
+}
+
+void freebloom(bloomptr_t *b) {
+  if (nullptr == b || nullptr == *b)
+    return;
+
+  free((*b)->bits);
+  free(*b);
+  *b = nullptr;
+}
+
+/*
+ * Agrega data si el filtro no la tenía (así las repetidas no cuentan) y,
+ * si se pasó de cap, lo rehace al doble desde el árbol.
+ */
+static err_t __blinsert(bloomptr_t b, btreeptr_t root, const void *data) {
+  if (EXIT_SUCCESS == findbloom(b, data))
+    return EXIT_SUCCESS;
+
+  __insbloom(b, data);
+  if (b->len <= b->cap)
+    return EXIT_SUCCESS;
+  if (EXIT_SUCCESS != __allocbloom(b, 2 * b->len))
+    return EXIT_FAILURE;
+  return rehashbloom(b, root);
+}
+
+/*
+ * Inserciones que mantienen el filtro. Un error del árbol no toca el
+ * filtro; si el árbol insertó pero no se pudo agrandar el filtro, este
+ * sigue sirviendo (con más falsos positivos) y se retorna EXIT_FAILURE.
+ */
+err_t blinsbtree(bloomptr_t b, btreeptr_t *const root, const void *data) {
+  if (nullptr == b)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t ret = insbtree(root, data, b->size);
+  if (EXIT_SUCCESS != ret)
+    return ret;
+  return __blinsert(b, *root, data);
+}
+
+err_t blfinsbtree(bloomptr_t b, btreeptr_t *const root, const void *data,
+                  const size_t size,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == b || size < b->size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t ret = finsbtree(root, data, size, cmp);
+  if (EXIT_SUCCESS != ret)
+    return ret;
+  return __blinsert(b, *root, data);
+}
+
+// findbtree/ffindbtree que miran el filtro primero
+err_t blfindbtree(bloomptr_t b, btreeptr_t root, void *data,
+                  btreeptr_t *ret) {
+  if (nullptr == b)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t e = findbloom(b, data);
+  if (EXIT_SUCCESS != e)
+    return e;
+  return findbtree(root, data, b->size, ret);
+}
+
+err_t blffindbtree(bloomptr_t b, btreeptr_t root, void *data, size_t size,
+                   btreeptr_t *ret,
+                   long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == b || size < b->size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t e = findbloom(b, data);
+  if (EXIT_SUCCESS != e)
+    return e;
+  return ffindbtree(root, data, size, ret, cmp);
+}
+
+// initarrbtree que llena el filtro desde el arreglo (secuencial, sin
+// recorrer el árbol). El filtro tiene que estar vacío
+err_t blinitarrbtree(bloomptr_t b, btarenaptr_t *const arena,
+                     btreeptr_t *const root, void *init_data,
+                     const size_t nmemb, const size_t size,
+                     int (*cmp)(const void *, const void *), const int sort) {
+  if (nullptr == b || size < b->size || b->len)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t ret = initarrbtree(arena, root, init_data, nmemb, size, cmp, sort);
+  if (EXIT_SUCCESS != ret)
+    return ret;
+  return arrbloom(b, init_data, nmemb, size);
+}
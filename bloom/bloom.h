@@ -0,0 +1,41 @@
+#include "bloom.c"
+
+#define BLOOM_H
+
+// Bloom filter over the first size bytes of each key. fpr is the target
+// false positive rate with hint keys. Link with -lm
+err_t initbloom(bloomptr_t *const b, const size_t size, const size_t hint,
+                const double fpr);
+err_t insbloom(bloomptr_t b, const void *data);
+
+// EXIT_FAILURE_NOT_FOUND means data was never added
+err_t findbloom(bloomptr_t b, const void *data);
+
+// Refill from the keys of a tree (after deletions, or when it grew past
+// hint). Grows the filter if needed
+err_t rehashbloom(bloomptr_t b, btreeptr_t root);
+
+// Add nmemb contiguous keys, stride bytes apart
+err_t arrbloom(bloomptr_t b, const void *data, const size_t nmemb,
+               const size_t stride);
+void freebloom(bloomptr_t *b);
+
+// Tree operations that keep b up to date and check it before searching.
+// Definite misses cost one hashed cache line. Keys are b->size bytes; with a
+// comparison function, cmp == 0 must imply equal first b->size bytes
+err_t blinsbtree(bloomptr_t b, btreeptr_t *const root, const void *data);
+err_t blfinsbtree(bloomptr_t b, btreeptr_t *const root, const void *data,
+                  const size_t size,
+                  long (*cmp)(const void *, const void *, size_t size));
+err_t blfindbtree(bloomptr_t b, btreeptr_t root, void *data,
+                  btreeptr_t *ret);
+err_t blffindbtree(bloomptr_t b, btreeptr_t root, void *data, size_t size,
+                   btreeptr_t *ret,
+                   long (*cmp)(const void *, const void *, size_t size));
+
+// initarrbtree filling an empty b straight from init_data. frehashbtree
+// keeps the keys, so b stays valid across it
+err_t blinitarrbtree(bloomptr_t b, btarenaptr_t *const arena,
+                     btreeptr_t *const root, void *init_data,
+                     const size_t nmemb, const size_t size,
+                     int (*cmp)(const void *, const void *), const int sort);
@@ -0,0 +1,292 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * B+-tree de verdad (no como btree/, que es un árbol binario):
+ * Cada nodo ocupa BPTREE_NODE_BYTES bytes y guarda muchas claves de tamaño
+ * fijo ordenadas dentro del mismo nodo, así que cada nivel cuesta un par de
+ * líneas de caché en lugar de un salto a un nodo de 24 bytes + otro a data.
+ *
+ * Las claves viven solo en las hojas (los nodos internos guardan copias
+ * como separadores) y las hojas están enlazadas en orden, por lo que el
+ * recorrido ordenado es un memcpy por hoja.
+ *
+ * Regla de guardado igual que btree/: menor a la izquierda, mayor a la
+ * derecha, igual no se guarda (EXIT_SUCCESS_REPEATED). Esto vale también
+ * con cmp propio: insbptree avisa siempre la repetida, aunque finsbtree
+ * en ese caso retorne EXIT_SUCCESS.
+ */
+
+#ifndef BPTREE_NODE_BYTES
+#define BPTREE_NODE_BYTES 256
+#endif
+
+typedef struct bpnode bpnode_t;
+typedef struct bptree bptree_t;
+typedef struct bptree *bptreeptr_t;
+
+struct bpnode {
+  bpnode_t *next; // Siguiente hoja, solo en hojas
+  unsigned int leaf;
+  unsigned int count; // Claves ocupadas
+  // Hojas: claves. Internos: icap + 1 hijos y después icap claves
+  _Alignas(max_align_t) char mem[];
+};
+
+struct bptree {
+  bpnode_t *root;
+  size_t size;      // Tamaño de cada clave
+  size_t lcap;      // Claves por hoja
+  size_t icap;      // Claves por nodo interno
+  size_t nodebytes; // Bytes de cada nodo, cabecera incluida
+  size_t len;       // Claves guardadas
+  size_t nodes;     // Nodos alojados
+  // nullptr indica usar memcmp
+  long (*cmp)(const void *mem1, const void *mem2, size_t size);
+};
+
+#define __bpchild(node) ((bpnode_t **)(node)->mem)
+#define __bplkey(tree, node, i) ((node)->mem + (i) * (tree)->size)
+#define __bpikey(tree, node, i)                                                \
+  ((node)->mem + ((tree)->icap + 1) * sizeof(bpnode_t *) + (i) * (tree)->size)
+
+static inline long __bpcmp(bptreeptr_t tree, const void *a, const void *b) {
+  if (tree->cmp)
+    return tree->cmp(a, b, tree->size);
+  return __builtin_memcmp(a, b, tree->size);
+}
+
+// cmp puede ser nullptr, en ese caso se compara con memcmp
+err_t initbptree(bptreeptr_t *const tree, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2,
+                             size_t size)) {
+  if (nullptr == tree || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *tree = (bptreeptr_t)malloc(sizeof(bptree_t));
+  if (nullptr == *tree)
+    return EXIT_FAILURE;
+
+  // Como mínimo 3 claves por nodo, si no no se puede partir
+  size_t bytes = BPTREE_NODE_BYTES - sizeof(bpnode_t);
+  if (bytes < sizeof(bpnode_t *) + 3 * (size + sizeof(bpnode_t *)))
+    bytes = sizeof(bpnode_t *) + 3 * (size + sizeof(bpnode_t *));
+
+  (*tree)->root = nullptr;
+  (*tree)->size = size;
+  (*tree)->lcap = bytes / size;
+  (*tree)->icap = (bytes - sizeof(bpnode_t *)) / (size + sizeof(bpnode_t *));
+  (*tree)->nodebytes = sizeof(bpnode_t) + bytes;
+  (*tree)->len = 0;
+  (*tree)->nodes = 0;
+  (*tree)->cmp = cmp;
+
+  return EXIT_SUCCESS;
+}
+
+static inline bpnode_t *__newbpnode(bptreeptr_t tree, const unsigned int leaf) {
+  bpnode_t *node = (bpnode_t *)malloc(tree->nodebytes);
+  if (nullptr == node)
+    return nullptr;
+
+  node->next = nullptr;
+  node->leaf = leaf;
+  node->count = 0;
+  ++tree->nodes;
+  return node;
+}
+
+// Primera clave de la hoja >= data
+static inline size_t __bplower(bptreeptr_t tree, bpnode_t *node,
+                               const void *data) {
+  size_t lo = 0, hi = node->count, mid;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (__bpcmp(tree, data, __bplkey(tree, node, mid)) > 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Hijo por el que hay que bajar: cantidad de separadores <= data
+static inline size_t __bpupper(bptreeptr_t tree, bpnode_t *node,
+                               const void *data) {
+  size_t lo = 0, hi = node->count, mid;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (__bpcmp(tree, data, __bpikey(tree, node, mid)) >= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static inline int __bpfull(bptreeptr_t tree, bpnode_t *node) {
+  return node->count == (node->leaf ? tree->lcap : tree->icap);
+}
+
+// Parte el hijo i (lleno) de parent (no lleno)
+static err_t __bpsplit(bptreeptr_t tree, bpnode_t *parent, const size_t i) {
+  bpnode_t *child = __bpchild(parent)[i];
+  bpnode_t *aux = __newbpnode(tree, child->leaf);
+  if (nullptr == aux)
+    return EXIT_FAILURE;
+
+  const size_t half = child->count / 2;
+  const char *sep;
+
+  if (child->leaf) {
+    aux->count = child->count - half;
+    memcpy(__bplkey(tree, aux, 0), __bplkey(tree, child, half),
+           aux->count * tree->size);
+    child->count = half;
+    aux->next = child->next;
+    child->next = aux;
+    sep = __bplkey(tree, aux, 0);
+  } else {
+    // La clave del medio sube al padre
+    aux->count = child->count - half - 1;
+    memcpy(__bpikey(tree, aux, 0), __bpikey(tree, child, half + 1),
+           aux->count * tree->size);
+    memcpy(__bpchild(aux), __bpchild(child) + half + 1,
+           (aux->count + 1) * sizeof(bpnode_t *));
+    child->count = half;
+    sep = __bpikey(tree, child, half);
+  }
+
+  memmove(__bpikey(tree, parent, i + 1), __bpikey(tree, parent, i),
+          (parent->count - i) * tree->size);
+  memmove(__bpchild(parent) + i + 2, __bpchild(parent) + i + 1,
+          (parent->count - i) * sizeof(bpnode_t *));
+  memcpy(__bpikey(tree, parent, i), sep, tree->size);
+  __bpchild(parent)[i + 1] = aux;
+  ++parent->count;
+
+  return EXIT_SUCCESS;
+}
+
+// Equivalente a insbtree. Los nodos llenos se parten al bajar, así nunca
+// hay que volver a subir.
+err_t insbptree(bptreeptr_t tree, const void *data) {
+  if (nullptr == tree || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (nullptr == tree->root) {
+    tree->root = __newbpnode(tree, 1);
+    if (nullptr == tree->root)
+      return EXIT_FAILURE;
+  }
+
+  if (__bpfull(tree, tree->root)) {
+    bpnode_t *aux = __newbpnode(tree, 0);
+    if (nullptr == aux)
+      return EXIT_FAILURE;
+    __bpchild(aux)[0] = tree->root;
+    if (EXIT_SUCCESS != __bpsplit(tree, aux, 0)) {
+      free(aux);
+      --tree->nodes;
+      return EXIT_FAILURE;
+    }
+    tree->root = aux;
+  }
+
+  bpnode_t *node = tree->root;
+  size_t i;
+
+  while (!node->leaf) {
+    i = __bpupper(tree, node, data);
+    if (__bpfull(tree, __bpchild(node)[i])) {
+      if (EXIT_SUCCESS != __bpsplit(tree, node, i))
+        return EXIT_FAILURE;
+      if (__bpcmp(tree, data, __bpikey(tree, node, i)) >= 0)
+        ++i;
+    }
+    node = __bpchild(node)[i];
+  }
+
+  i = __bplower(tree, node, data);
+  if (i < node->count && 0 == __bpcmp(tree, data, __bplkey(tree, node, i)))
+    return EXIT_SUCCESS_REPEATED;
+
+  memmove(__bplkey(tree, node, i + 1), __bplkey(tree, node, i),
+          (node->count - i) * tree->size);
+  memcpy(__bplkey(tree, node, i), data, tree->size);
+  ++node->count;
+  ++tree->len;
+
+  return EXIT_SUCCESS;
+}
+
+// Equivalente a findbtree. Guarda en *ret la dirección de la clave dentro
+// de su hoja, válida hasta la siguiente inserción.
+err_t findbptree(bptreeptr_t tree, const void *data, void **const ret) {
+  if (nullptr == tree || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  bpnode_t *node = tree->root;
+  if (nullptr == node)
+    return EXIT_FAILURE_NOT_FOUND;
+
+  while (!node->leaf)
+    node = __bpchild(node)[__bpupper(tree, node, data)];
+
+  size_t i = __bplower(tree, node, data);
+  if (i < node->count && 0 == __bpcmp(tree, data, __bplkey(tree, node, i))) {
+    *ret = __bplkey(tree, node, i);
+    return EXIT_SUCCESS;
+  }
+
+  return EXIT_FAILURE_NOT_FOUND;
+}
+
+// Equivalente a arrbtree, pero *dst son las claves mismas (len * size bytes)
+// y no punteros a ellas. Un memcpy por hoja.
+err_t arrbptree(void **dst, bptreeptr_t tree, size_t *len) {
+  if (nullptr == dst || nullptr == tree || nullptr == len)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *dst = malloc(tree->len * tree->size + 1);
+  if (nullptr == *dst)
+    return EXIT_FAILURE;
+
+  bpnode_t *node = tree->root;
+  while (node && !node->leaf)
+    node = __bpchild(node)[0];
+
+  char *aux = (char *)*dst;
+  for (; node; node = node->next) {
+    memcpy(aux, node->mem, node->count * tree->size);
+    aux += node->count * tree->size;
+  }
+  *len = tree->len;
+
+  return EXIT_SUCCESS;
+}
+
+// La altura es log_B(n), la recursión no es problema
+static void __freebpnode(bpnode_t *node) {
+  if (!node->leaf)
+    for (size_t i = 0; i <= node->count; ++i)
+      __freebpnode(__bpchild(node)[i]);
+  free(node);
+}
+
+// Como freebtree, si tree es nullptr no hace nada
+void freebptree(bptreeptr_t *tree) {
+  if (nullptr == tree || nullptr == *tree)
+    return;
+
+  if ((*tree)->root)
+    __freebpnode((*tree)->root);
+  free(*tree);
+  *tree = nullptr;
+}
@@ -0,0 +1,25 @@
+/*
+ * Written by Thostin
+ * Github: https://github.com/Thostin
+ */
+
+#include "bptree.c"
+
+#define BPTREE_H
+
+// Create an empty B+-tree for keys of a fixed size. cmp may be nullptr to use
+// __builtin_memcmp for comparision
+err_t initbptree(bptreeptr_t *const tree, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size));
+
+// Insert a key. EXIT_SUCCESS_REPEATED if it was already there, with or
+// without cmp (like insbtree; note finsbtree returns EXIT_SUCCESS instead)
+err_t insbptree(bptreeptr_t tree, const void *data);
+
+// Find a key, *ret points to the copy stored inside the tree
+err_t findbptree(bptreeptr_t tree, const void *data, void **const ret);
+
+// Ordered scan: *dst is a malloc'd array holding the *len keys themselves
+err_t arrbptree(void **dst, bptreeptr_t tree, size_t *len);
+
+void freebptree(bptreeptr_t *tree);
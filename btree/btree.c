@@ -1,3 +1,5 @@
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +12,10 @@
 #include "../defs/defs.h"
 #endif
 
+#ifndef STATS_H
+#include "../stats/stats.h"
+#endif
+
 #define next(node) node = node->next
 
 typedef struct btree btree_t;
@@ -52,12 +58,15 @@ err_t initbtree(btreeptr_t *const root, const void *data, const size_t size) {
   *root = (btreeptr_t)malloc(sizeof(btree_t));
   if (nullptr == *root)
     return EXIT_FAILURE;
+  STAT_ALLOC(STATS_BTREE, sizeof(btree_t));
 
   (*root)->data = malloc(size);
   if (nullptr == (*root)->data) {
     free(*root);
-    EXIT_FAILURE;
+    *root = nullptr;
+    return EXIT_FAILURE;
   }
+  STAT_ALLOC(STATS_BTREE, size);
 
   memcpy((*root)->data, data, size);
 
@@ -77,6 +86,7 @@ err_t finsbtree(btreeptr_t *const root, const void *data, const size_t size,
   if (nullptr == root || nullptr == data)
     return EXIT_FAILURE_IMPROPER_USE;
 
+  STAT_SCOPE(STATS_BTREE_INSERT);
   if (nullptr == *root) {
     initbtree(root, data, size);
     return EXIT_SUCCESS;
@@ -90,20 +100,19 @@ err_t finsbtree(btreeptr_t *const root, const void *data, const size_t size,
     if (nullptr == node->data)
       return EXIT_FAILURE_IMPROPER_USE;
 
+    STAT_VISIT();
+    STAT_COMPARE();
     _compare_ = cmp(data, node->data, size);
     if (0 == _compare_) {
-      // printf("EQUAL\n");
       return EXIT_SUCCESS;
     }
     if (_compare_ > 0) {
-      // printf("RIGHT\n");
       if (nullptr == node->right) {
         aux = &(node->right);
         return initbtree(aux, data, size);
       }
       node = node->right;
     } else {
-      // printf("LEFT\n");
       if (nullptr == node->left) {
         // Technically, this specific assigment is not necessary:
         aux = &(node->left);
@@ -121,6 +130,7 @@ err_t insbtree(btreeptr_t *const root, const void *data, const size_t size) {
   if (nullptr == root || nullptr == data)
     return EXIT_FAILURE_IMPROPER_USE;
 
+  STAT_SCOPE(STATS_BTREE_INSERT);
   if (nullptr == *root) {
     initbtree(root, data, size);
     return EXIT_SUCCESS;
@@ -134,20 +144,19 @@ err_t insbtree(btreeptr_t *const root, const void *data, const size_t size) {
     if (nullptr == node->data)
       return EXIT_FAILURE_IMPROPER_USE;
 
+    STAT_VISIT();
+    STAT_COMPARE();
     _compare_ = __builtin_memcmp(data, node->data, size);
     if (0 == _compare_) {
-      // printf("EQUAL\n");
       return EXIT_SUCCESS_REPEATED;
     }
     if (_compare_ > 0) {
-      // printf("RIGHT\n");
       if (nullptr == node->right) {
         aux = &(node->right);
         return initbtree(aux, data, size);
       }
       node = node->right;
     } else {
-      // printf("LEFT\n");
       if (nullptr == node->left) {
         // Technically, this specific assigment is not necessary:
         aux = &(node->left);
@@ -159,295 +168,1878 @@ err_t insbtree(btreeptr_t *const root, const void *data, const size_t size) {
   }
 }
 
-// Assumes non-null root, not recommended using directly
-static void __freebtree(btreeptr_t *root) {
-  if ((*root)->left)
-    __freebtree(&((*root)->left));
-  if ((*root)->left)
-    __freebtree(&((*root)->right));
+/*
+ * Inserción balanceada (AVL):
+ * Cada nodo lleva además su altura, pero empieza con un btree_t, así que
+ * los punteros left/right siguen siendo btreeptr_t y findbtree, ffindbtree,
+ * arrbtree, freebtree, etc. funcionan igual sobre estos árboles.
+ *
+ * Un árbol AVL se arma SOLO con avlinsbtree/favlinsbtree, no se deben
+ * mezclar con insbtree/finsbtree (esos nodos no tienen altura).
+ * Para rebalancear usar avlfrehashbtree(...), frehashbtree(...) a secas deja
+ * las alturas y tamaños viejos.
+ *
+ * Cada nodo también lleva el tamaño de su subárbol, así avlsizebtree es O(1)
+ * y avlrankbtree/avlselectbtree (estadísticos de orden) son O(log n).
+ */
+typedef struct avlbtree avlbtree_t;
 
-  free((*root)->data);
-  free(*root);
-  *root = nullptr;
+struct avlbtree {
+  btree_t node;
+  long height;
+  size_t size; // Nodos del subárbol, este incluido
+};
+
+// Sobra para 2^64 nodos: la altura de un AVL es menor a 1.45 log2(n + 2)
+#define AVL_MAX_HEIGHT 96
+
+#define __avlh(node) ((node) ? ((avlbtree_t *)(node))->height : 0)
+#define __avls(node) ((node) ? ((avlbtree_t *)(node))->size : 0)
+
+static inline void __avlfix(btreeptr_t node) {
+  long l = __avlh(node->left), r = __avlh(node->right);
+  ((avlbtree_t *)node)->height = 1 + (l > r ? l : r);
+  ((avlbtree_t *)node)->size = 1 + __avls(node->left) + __avls(node->right);
 }
 
-// Following same way as C standard: If ptr is nullptr, no action is made
-void freebtree(btreeptr_t *root) {
-  if (root)
-    __freebtree(root);
+static inline btreeptr_t __avlrotr(btreeptr_t node) {
+  btreeptr_t aux = node->left;
+  node->left = aux->right;
+  aux->right = node;
+  __avlfix(node);
+  __avlfix(aux);
+  return aux;
 }
 
-// uses memcmp
-// Stores node address to *ret
-err_t findbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret) {
+static inline btreeptr_t __avlrotl(btreeptr_t node) {
+  btreeptr_t aux = node->right;
+  node->right = aux->left;
+  aux->left = node;
+  __avlfix(node);
+  __avlfix(aux);
+  return aux;
+}
+
+// Retorna la nueva raíz del subárbol
+static inline btreeptr_t __avlbalance(btreeptr_t node) {
+  __avlfix(node);
+  long bal = __avlh(node->left) - __avlh(node->right);
+
+  if (bal > 1) {
+    if (__avlh(node->left->left) < __avlh(node->left->right))
+      node->left = __avlrotl(node->left);
+    return __avlrotr(node);
+  }
+  if (bal < -1) {
+    if (__avlh(node->right->right) < __avlh(node->right->left))
+      node->right = __avlrotr(node->right);
+    return __avlrotl(node);
+  }
+  return node;
+}
+
+static inline err_t __initavlbtree(btreeptr_t *const root, const void *data,
+                                   const size_t size) {
+  avlbtree_t *aux = (avlbtree_t *)malloc(sizeof(avlbtree_t));
+  if (nullptr == aux)
+    return EXIT_FAILURE;
+  STAT_ALLOC(STATS_BTREE, sizeof(avlbtree_t));
+
+  aux->node.data = malloc(size);
+  if (nullptr == aux->node.data) {
+    free(aux);
+    return EXIT_FAILURE;
+  }
+  STAT_ALLOC(STATS_BTREE, size);
+
+  memcpy(aux->node.data, data, size);
+  aux->node.left = nullptr;
+  aux->node.right = nullptr;
+  aux->height = 1;
+  aux->size = 1;
+  *root = &(aux->node);
+
+  return EXIT_SUCCESS;
+}
+
+// Sube por el camino recorrido rebalanceando. path[i] es el enlace (del
+// padre) que apunta al nodo de profundidad i.
+// Cuando las alturas dejan de cambiar ya no hay que rotar, pero los tamaños
+// sí cambian hasta la raíz.
+static inline void __avlretrace(btreeptr_t **path, long depth) {
+  long old;
+  btreeptr_t aux;
+
+  while (depth--) {
+    old = __avlh(*path[depth]);
+    aux = __avlbalance(*path[depth]);
+    if (aux == *path[depth] && old == __avlh(aux))
+      break;
+    *path[depth] = aux;
+  }
+
+  while (depth-- > 0)
+    __avlfix(*path[depth]);
+}
+
+// Igual que finsbtree, pero mantiene el árbol balanceado
+err_t favlinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                   long (*cmp)(const void *mem1, const void *mem2,
+                               size_t size)) {
 
   if (nullptr == root || nullptr == data)
     return EXIT_FAILURE_IMPROPER_USE;
 
-  int _compare_;
-  btreeptr_t node = root;
+  STAT_SCOPE(STATS_BTREE_INSERT);
+  btreeptr_t *path[AVL_MAX_HEIGHT];
+  long depth = 0;
+  long _compare_;
+  btreeptr_t *link = root;
 
-  while (1) {
-    if (nullptr == node->data)
+  while (*link) {
+    if (nullptr == (*link)->data || AVL_MAX_HEIGHT == depth)
       return EXIT_FAILURE_IMPROPER_USE;
 
-    _compare_ = __builtin_memcmp(data, node->data, size);
-    if (0 == _compare_) {
-      // printf("EQUAL\n");
-      *ret = node;
+    STAT_VISIT();
+    STAT_COMPARE();
+    _compare_ = cmp(data, (*link)->data, size);
+    if (0 == _compare_)
       return EXIT_SUCCESS;
-    }
-
-    if (_compare_ > 0) {
-      // printf("RIGHT\n");
-      if (nullptr == node->right)
-        return EXIT_FAILURE_NOT_FOUND;
-      node = node->right;
-    } else {
-      // printf("LEFT\n");
-      if (nullptr == node->left)
-        return EXIT_FAILURE_NOT_FOUND;
 
-      node = node->left;
-    }
+    path[depth++] = link;
+    link = _compare_ > 0 ? &((*link)->right) : &((*link)->left);
   }
+
+  if (EXIT_SUCCESS != __initavlbtree(link, data, size))
+    return EXIT_FAILURE;
+
+  __avlretrace(path, depth);
+  return EXIT_SUCCESS;
 }
 
-err_t ffindbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret,
-                 long (*cmp)(const void *, const void *, size_t size)) {
+// Igual que insbtree (memcmp), pero mantiene el árbol balanceado
+err_t avlinsbtree(btreeptr_t *const root, const void *data, const size_t size) {
 
   if (nullptr == root || nullptr == data)
     return EXIT_FAILURE_IMPROPER_USE;
 
+  STAT_SCOPE(STATS_BTREE_INSERT);
+  btreeptr_t *path[AVL_MAX_HEIGHT];
+  long depth = 0;
   int _compare_;
-  btreeptr_t node = root;
+  btreeptr_t *link = root;
 
-  while (1) {
+  while (*link) {
+    if (nullptr == (*link)->data || AVL_MAX_HEIGHT == depth)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    STAT_VISIT();
+    STAT_COMPARE();
+    _compare_ = __builtin_memcmp(data, (*link)->data, size);
+    if (0 == _compare_)
+      return EXIT_SUCCESS_REPEATED;
+
+    path[depth++] = link;
+    link = _compare_ > 0 ? &((*link)->right) : &((*link)->left);
+  }
+
+  if (EXIT_SUCCESS != __initavlbtree(link, data, size))
+    return EXIT_FAILURE;
+
+  __avlretrace(path, depth);
+  return EXIT_SUCCESS;
+}
+
+// Cantidad de nodos de un árbol AVL, O(1)
+size_t avlsizebtree(btreeptr_t root) { return __avls(root); }
+
+static err_t __avlrankbtree(btreeptr_t node, const void *data,
+                            const size_t size, size_t *rank,
+                            long (*cmp)(const void *, const void *, size_t)) {
+  if (nullptr == data || nullptr == rank)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  size_t r = 0;
+  long _compare_;
+
+  while (node) {
     if (nullptr == node->data)
       return EXIT_FAILURE_IMPROPER_USE;
 
-    _compare_ = cmp(data, node->data, size);
+    _compare_ = cmp ? cmp(data, node->data, size)
+                    : __builtin_memcmp(data, node->data, size);
     if (0 == _compare_) {
-      // printf("EQUAL\n");
-      *ret = node;
+      *rank = r + __avls(node->left);
       return EXIT_SUCCESS;
     }
 
     if (_compare_ > 0) {
-      // printf("RIGHT\n");
-      if (nullptr == node->right)
-        return EXIT_FAILURE_NOT_FOUND;
+      r += __avls(node->left) + 1;
       node = node->right;
-
     } else {
-      // printf("LEFT\n");
-      if (nullptr == node->left)
-        return EXIT_FAILURE_NOT_FOUND;
-
       node = node->left;
     }
   }
+
+  *rank = r;
+  return EXIT_FAILURE_NOT_FOUND;
 }
 
-static listptr_t __arrbtree_node = nullptr;
-static size_t __arrbtree_len = 0;
+// *rank es la cantidad de claves menores a data (memcmp), esté o no data.
+// EXIT_FAILURE_NOT_FOUND si data no está. Solo árboles AVL
+err_t avlrankbtree(btreeptr_t root, const void *data, const size_t size,
+                   size_t *rank) {
+  return __avlrankbtree(root, data, size, rank, nullptr);
+}
 
-static inline err_t __arrbtree(btreeptr_t node) {
-  if (nullptr == node) {
-    // printf("nullptr node\n");
-    return EXIT_SUCCESS;
+err_t favlrankbtree(btreeptr_t root, const void *data, const size_t size,
+                    size_t *rank,
+                    long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __avlrankbtree(root, data, size, rank, cmp);
+}
+
+// *ret es el k-ésimo menor, desde 0. Solo árboles AVL
+err_t avlselectbtree(btreeptr_t root, size_t k, btreeptr_t *ret) {
+  if (nullptr == ret)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  size_t left;
+  while (root) {
+    left = __avls(root->left);
+    if (k == left) {
+      *ret = root;
+      return EXIT_SUCCESS;
+    }
+
+    if (k < left) {
+      root = root->left;
+    } else {
+      k -= left + 1;
+      root = root->right;
+    }
   }
-  // printf("HERE\n");
-  if (EXIT_SUCCESS != __arrbtree(node->left))
-    return EXIT_FAILURE;
 
-  if (nullptr != node->data) {
-    ++__arrbtree_len;
-    pushl(__arrbtree_node, &(node->data), 8);
-    next(__arrbtree_node);
+  return EXIT_FAILURE_NOT_FOUND;
+}
+
+/*
+ * Borrado:
+ * El nodo se desengancha y se libera (nodo y data) en el momento. Si tiene
+ * dos hijos, su lugar lo toma su sucesor o su predecesor, moviendo el nodo
+ * (no copiando data), así los btreeptr_t que tenga el llamador a otros nodos
+ * siguen valiendo.
+ * ---delbtree/fdelbtree: árboles comunes. Para que borrar mucho no incline
+ * el árbol siempre al mismo lado, el reemplazo sale del lado más profundo
+ * medido por la espina que hay que bajar (la derecha del hijo izquierdo
+ * hasta el predecesor, la izquierda del derecho hasta el sucesor): se
+ * bajan las dos a la par hasta que una termina. Depende solo de la forma
+ * del árbol, así que dos corridas iguales dan el mismo árbol.
+ * ---avldelbtree/favldelbtree: árboles AVL, se rebalancea al subir igual
+ * que al insertar, la altura sigue siendo O(log n).
+ * NO usar con árboles de arena (ver freebtarena).
+ */
+static err_t __delbtree(btreeptr_t *const root, const void *data,
+                        const size_t size,
+                        long (*cmp)(const void *, const void *, size_t),
+                        const int avl) {
+  if (nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  btreeptr_t *path[AVL_MAX_HEIGHT];
+  long depth = 0, _compare_;
+  btreeptr_t *link = root, node, aux;
+
+  while (1) {
+    node = *link;
+    if (nullptr == node)
+      return EXIT_FAILURE_NOT_FOUND;
+    if (nullptr == node->data || (avl && AVL_MAX_HEIGHT == depth))
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    _compare_ = cmp ? cmp(data, node->data, size)
+                    : __builtin_memcmp(data, node->data, size);
+    if (0 == _compare_)
+      break;
+
+    if (avl)
+      path[depth++] = link;
+    link = _compare_ > 0 ? &(node->right) : &(node->left);
+  }
+
+  if (nullptr == node->left || nullptr == node->right) {
+    *link = node->left ? node->left : node->right;
   } else {
-    // printf("NULL_POINTER\n");
-    return EXIT_FAILURE;
+    // El nodo queda en path[depth], el reemplazo va a ocupar ese lugar
+    const long at = depth;
+    int pred;
+    btreeptr_t *slot;
+
+    if (avl) {
+      path[depth++] = link;
+      pred = __avlh(node->left) > __avlh(node->right);
+    } else {
+      // Empate: el lado cuyo extremo todavía tiene un hijo
+      btreeptr_t l = node->left, r = node->right;
+      while (l->right && r->left) {
+        l = l->right;
+        r = r->left;
+      }
+      pred = l->right ? 1 : r->left ? 0 : nullptr != l->left;
+    }
+
+    slot = pred ? &(node->left) : &(node->right);
+    while (pred ? (*slot)->right : (*slot)->left) {
+      if (avl) {
+        if (AVL_MAX_HEIGHT == depth)
+          return EXIT_FAILURE_IMPROPER_USE;
+        path[depth++] = slot;
+      }
+      slot = pred ? &((*slot)->right) : &((*slot)->left);
+    }
+
+    aux = *slot;
+    *slot = pred ? aux->left : aux->right;
+    aux->left = node->left;
+    aux->right = node->right;
+    *link = aux;
+
+    if (avl) {
+      // El primer enlace guardado debajo del nodo vivía dentro de él
+      if (depth > at + 1)
+        path[at + 1] = pred ? &(aux->left) : &(aux->right);
+      // Así __avlretrace ve el cambio de altura real en esa posición
+      ((avlbtree_t *)aux)->height = ((avlbtree_t *)node)->height;
+      ((avlbtree_t *)aux)->size = ((avlbtree_t *)node)->size;
+    }
   }
 
-  if (EXIT_SUCCESS != __arrbtree(node->right))
-    return EXIT_FAILURE;
+  free(node->data);
+  free(node);
 
+  if (avl)
+    __avlretrace(path, depth);
   return EXIT_SUCCESS;
 }
 
-// Transforma dst en un arreglo de punteros a los datos del árbol binario.
-// Es fácil acceder a los punteros que apuntan a las ramaas inferiores del
-// árbol, simplemete hay que mirar cómo está declarada la estructura
-err_t arrbtree(void **dst, btreeptr_t node, size_t *len) {
-  // printf("__ARRBTREE_LEN BEFOREHAND: %ld\n", __arrbtree_len);
-  list_t root; // Esta variable es para hackear las funciones que hice, estoy
-               // desperdiciando 16 bytes de memoria
+// Borra data comparando con memcmp. EXIT_FAILURE_NOT_FOUND si no estaba
+err_t delbtree(btreeptr_t *const root, const void *data, const size_t size) {
+  return __delbtree(root, data, size, nullptr, 0);
+}
+
+err_t fdelbtree(btreeptr_t *const root, const void *data, const size_t size,
+                long (*cmp)(const void *mem1, const void *mem2, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __delbtree(root, data, size, cmp, 0);
+}
 
-  err_t ret = EXIT_SUCCESS;
+err_t avldelbtree(btreeptr_t *const root, const void *data,
+                  const size_t size) {
+  return __delbtree(root, data, size, nullptr, 1);
+}
 
-  __arrbtree_node = &root;
-  root.data = (void *)0x1; // Make sure data pointer is not nullptr
+err_t favldelbtree(btreeptr_t *const root, const void *data,
+                   const size_t size,
+                   long (*cmp)(const void *mem1, const void *mem2,
+                               size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __delbtree(root, data, size, cmp, 1);
+}
 
-  if (EXIT_FAILURE == __arrbtree(node)) {
-    freel(&(root.next));
-    goto err;
+// Assumes non-null root, not recommended using directly
+// Sin recursión: mientras haya hijo izquierdo se rota a la derecha, así el
+// nodo actual nunca tiene izquierdo y se puede liberar y seguir por la
+// derecha. O(n) y memoria constante, sirve para árboles de cualquier altura.
+static void __freebtree(btreeptr_t *root) {
+  btreeptr_t node = *root, aux;
+
+  while (node) {
+    if (node->left) {
+      aux = node->left;
+      node->left = aux->right;
+      aux->right = node;
+      node = aux;
+    } else {
+      aux = node->right;
+      free(node->data);
+      free(node);
+      node = aux;
+    }
   }
 
-  *dst = malloc(8 * __arrbtree_len);
+  *root = nullptr;
+}
 
-  if (nullptr == *dst)
-    goto err;
+// Following same way as C standard: If ptr is nullptr, no action is made
+void freebtree(btreeptr_t *root) {
+  if (root)
+    __freebtree(root);
+}
 
-  if (EXIT_SUCCESS != compactl(root.next, *dst, 8)) {
-    free(*dst);
-    *dst = nullptr;
-    goto err;
-  }
-  *len = __arrbtree_len;
+/*
+ * Cursor en orden:
+ * Guarda los ancestros pendientes en una pila propia, de BTREE_MAX_HEIGHT
+ * lugares dentro del cursor; solo si el árbol es más alto que eso pasa a
+ * una pila en el heap. No toca el árbol, así que se puede buscar en él y
+ * tener varios cursores (o lectores en otros hilos) a la vez. Lo que no se
+ * puede es insertar, borrar ni rebalancear mientras está abierto.
+ * Al llegar al final no queda nada alojado. Si se corta antes, llamar a
+ * endbtree(...) para liberar la pila del heap, si la hubo.
+ *
+ *   btcursor_t it;
+ *   for (err_t e = beginbtree(&it, root); !e; e = nextbtree(&it))
+ *     usar(it.node->data);
+ *
+ * EXIT_FAILURE (sin memoria para la pila) también termina el recorrido.
+ */
+#ifndef BTREE_MAX_HEIGHT
+#define BTREE_MAX_HEIGHT 64
+#endif
 
-  /*
-  printf("SEE IF IT WORKS:\n");
-  printf("__arrbtree_len = %ld\n", __arrbtree_len);
+typedef struct {
+  btreeptr_t node;  // Nodo actual, nullptr al terminar
+  btreeptr_t *heap; // Pila en el heap, nullptr mientras alcance fixed
+  size_t top, cap;
+  btreeptr_t fixed[BTREE_MAX_HEIGHT];
+} btcursor_t;
+
+// Cierra el cursor, hace falta solo si se cortó el recorrido
+void endbtree(btcursor_t *it) {
+  if (nullptr == it)
+    return;
+
+  free(it->heap);
+  it->heap = nullptr;
+  it->node = nullptr;
+  it->top = 0;
+}
 
-  type **arr = (type **)*dst;
+// Deja el cursor vacío, con la pila en fixed
+static inline void __resetbtree(btcursor_t *it) {
+  it->node = nullptr;
+  it->heap = nullptr;
+  it->top = 0;
+  it->cap = BTREE_MAX_HEIGHT;
+}
 
-  for (int i = 0; i < __arrbtree_len; ++i) {
-    printf("%ld ", *(arr[i]));
+// Apila node; la pila pasa al heap (y crece al doble) si no alcanza
+static err_t __pushbtree(btcursor_t *it, btreeptr_t node) {
+  if (it->top == it->cap) {
+    btreeptr_t *aux =
+        (btreeptr_t *)realloc(it->heap, 2 * it->cap * sizeof(btreeptr_t));
+    if (nullptr == aux)
+      return EXIT_FAILURE;
+    if (nullptr == it->heap)
+      memcpy(aux, it->fixed, it->top * sizeof(btreeptr_t));
+    it->heap = aux;
+    it->cap *= 2;
   }
-  putchar(10);
-  */
-  // Este paso es muy importante
-  goto success;
-err:
-  ret = EXIT_FAILURE;
-success:
-  freel(&(root.next));
-  __arrbtree_len = 0;
-  __arrbtree_node = nullptr;
+  (it->heap ? it->heap : it->fixed)[it->top++] = node;
+  return EXIT_SUCCESS;
+}
 
-  return ret;
+static inline btreeptr_t __popbtree(btcursor_t *it) {
+  return (it->heap ? it->heap : it->fixed)[--it->top];
 }
 
-static listptr_t __nodearrbtree_node;
-static size_t __nodearrbtree_len = 0;
+// Apila node y toda su rama izquierda
+static err_t __spinebtree(btcursor_t *it, btreeptr_t node) {
+  for (; node; node = node->left)
+    if (EXIT_SUCCESS != __pushbtree(it, node))
+      return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
 
-static inline err_t __nodearrbtree(btreeptr_t node) {
-  if (nullptr == node) {
-    // printf("nullptr node\n");
-    return EXIT_SUCCESS;
+static err_t __stepbtree(btcursor_t *it) {
+  if (0 == it->top) {
+    endbtree(it);
+    return EXIT_FAILURE_NOT_FOUND;
   }
-  // printf("HERE\n");
-  if (EXIT_SUCCESS != __nodearrbtree(node->left))
+
+  it->node = __popbtree(it);
+  if (EXIT_SUCCESS != __spinebtree(it, it->node->right)) {
+    endbtree(it);
     return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
 
-  if (nullptr != node->data) {
-    ++__nodearrbtree_len;
-    pushl(__nodearrbtree_node, node, 8);
-    next(__nodearrbtree_node);
-  } else {
-    // printf("NULL_POINTER\n");
+// Se posiciona en el menor. EXIT_FAILURE_NOT_FOUND si el árbol está vacío
+err_t beginbtree(btcursor_t *it, btreeptr_t root) {
+  if (nullptr == it)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __resetbtree(it);
+  if (EXIT_SUCCESS != __spinebtree(it, root)) {
+    endbtree(it);
     return EXIT_FAILURE;
   }
+  return __stepbtree(it);
+}
+
+// Avanza al siguiente. EXIT_FAILURE_NOT_FOUND al pasar el último
+err_t nextbtree(btcursor_t *it) {
+  if (nullptr == it || nullptr == it->node)
+    return EXIT_FAILURE_IMPROPER_USE;
 
-  return __nodearrbtree(node->right);
+  return __stepbtree(it);
 }
 
-// Mismo que arrbtree, pero retorna punteros a los nodos en lugar de los datos
-err_t nodearrbtree(btreeptr_t **dst, btreeptr_t node, size_t *len) {
-  // printf("__ARRBTREE_LEN BEFOREHAND: %ld\n", __arrbtree_len);
-  list_t root; // Esta variable es para hackear las funciones que hice, estoy
-               // desperdiciando 16 bytes de memoria
+/*
+ * Modo arena (opcional):
+ * Los nodos y sus datos, que deben ser todos del mismo tamaño, se sacan de
+ * bloques grandes (slabs) en lugar de hacer dos malloc por nodo. El dato
+ * queda inmediatamente después del nodo en memoria, por lo que findbtree(...)
+ * y compañía funcionan sin cambios y sin saltar a otra zona de memoria.
+ *
+ * IMPORTANTE: un árbol construido con ainsbtree/afinsbtree se libera
+ * entero con freebtarena(...), NUNCA con freebtree(...).
+ *
+ * allocs y bytes están para medir: cantidad de malloc hechos por la arena y
+ * bytes efectivamente entregados a nodos (nodo + dato + alineación).
+ */
+typedef struct btslab btslab_t;
+typedef struct btarena btarena_t;
+typedef struct btarena *btarenaptr_t;
+
+struct btslab {
+  btslab_t *next;
+  size_t used, cap; // En nodos
+  _Alignas(max_align_t) char mem[];
+};
 
-  err_t ret = EXIT_SUCCESS;
+struct btarena {
+  btslab_t *slab; // Slab actual, apunta a los anteriores
+  size_t size;    // Tamaño fijo de cada dato
+  size_t stride;  // sizeof(btree_t) + size, alineado
+  size_t allocs;
+  size_t bytes;
+};
 
-  __nodearrbtree_node = &root;
-  root.data = (void *)0x1; // Make sure data pointer is not nullptr
+#define BTARENA_MIN_SLAB 64
 
-  if (EXIT_FAILURE == __nodearrbtree(node)) {
-    // freel(&(root.next));
-    goto err;
-  }
+// hint es la cantidad de nodos esperada para el primer slab, puede ser 0
+err_t initbtarena(btarenaptr_t *const arena, const size_t size,
+                  const size_t hint) {
+  if (nullptr == arena || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
 
-  *dst = malloc(8 * __nodearrbtree_len);
+  *arena = (btarenaptr_t)malloc(sizeof(btarena_t));
+  if (nullptr == *arena)
+    return EXIT_FAILURE;
 
-  if (nullptr == *dst)
-    goto err;
+  const size_t align = _Alignof(max_align_t);
+  (*arena)->size = size;
+  (*arena)->stride = (sizeof(btree_t) + size + align - 1) / align * align;
+  (*arena)->slab = nullptr;
+  (*arena)->allocs = 1;
+  (*arena)->bytes = 0;
+
+  // El primer slab se pide de una, así el hint sirve de algo
+  btslab_t *slab = (btslab_t *)malloc(
+      sizeof(btslab_t) +
+      (*arena)->stride * (hint > BTARENA_MIN_SLAB ? hint : BTARENA_MIN_SLAB));
+  if (nullptr == slab) {
+    free(*arena);
+    *arena = nullptr;
+    return EXIT_FAILURE;
+  }
+  slab->next = nullptr;
+  slab->used = 0;
+  slab->cap = hint > BTARENA_MIN_SLAB ? hint : BTARENA_MIN_SLAB;
+  (*arena)->slab = slab;
+  ++(*arena)->allocs;
 
-  if (EXIT_SUCCESS != compactl(root.next, *dst, 8)) {
-    free(*dst);
-    *dst = nullptr;
-    goto err;
+  return EXIT_SUCCESS;
+}
+
+// Cada slab nuevo es el doble del anterior, así que son O(log n) malloc
+static inline btreeptr_t __btarena_node(btarenaptr_t arena) {
+  btslab_t *slab = arena->slab;
+
+  if (slab->used == slab->cap) {
+    slab = (btslab_t *)malloc(sizeof(btslab_t) +
+                              arena->stride * arena->slab->cap * 2);
+    if (nullptr == slab)
+      return nullptr;
+    slab->next = arena->slab;
+    slab->used = 0;
+    slab->cap = arena->slab->cap * 2;
+    arena->slab = slab;
+    ++arena->allocs;
   }
-  *len = __nodearrbtree_len;
 
-  /*
-  printf("SEE IF IT WORKS:\n");
-  printf("__arrbtree_len = %ld\n", __arrbtree_len);
+  btreeptr_t node = (btreeptr_t)(slab->mem + arena->stride * slab->used++);
+  arena->bytes += arena->stride;
+  return node;
+}
 
-  type **arr = (type **)*dst;
+// Igual que initbtree, pero el nodo y el dato salen de la arena
+err_t ainitbtree(btarenaptr_t arena, btreeptr_t *const root,
+                 const void *data) {
+  if (nullptr == arena || nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
 
-  for (int i = 0; i < __arrbtree_len; ++i) {
-    printf("%ld ", *(arr[i]));
-  }
-  putchar(10);
-  */
-  // Este paso es muy importante
-  goto success;
-err:
-  ret = EXIT_FAILURE;
-success:
-  freel(&(root.next));
-  __nodearrbtree_len = 0;
-  __nodearrbtree_node = nullptr;
+  *root = __btarena_node(arena);
+  if (nullptr == *root)
+    return EXIT_FAILURE;
 
-  return ret;
+  (*root)->data = (char *)*root + sizeof(btree_t);
+  memcpy((*root)->data, data, arena->size);
+  (*root)->left = nullptr;
+  (*root)->right = nullptr;
+
+  return EXIT_SUCCESS;
 }
 
-static int (*__frehashbtree_cmp)(const void *, const void *);
+// Igual que finsbtree, el tamaño del dato es el de la arena
+err_t afinsbtree(btarenaptr_t arena, btreeptr_t *const root, const void *data,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size)) {
 
-// Makes the binary tree faster after processing it
-static inline btreeptr_t __frehashbtree(btreeptr_t *arr, size_t len) {
-  switch (len) {
-    // case 0 is nearly never reachen, unless the programmer calls the function
-    // with it
-  case 0:
-    return nullptr;
-  case 1:
-    // Make sure that left and right pointers are null, othercase we will
-    // destroy our computer
-    (*arr)->right = nullptr;
-    (*arr)->left = nullptr;
-    return *arr;
-  case 2:
-    if (__frehashbtree_cmp((arr[1])->data, (arr[0])->data) > 0) {
-      arr[0]->right = arr[1];
-      arr[0]->left = nullptr;
+  if (nullptr == arena || nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (nullptr == *root)
+    return ainitbtree(arena, root, data);
+
+  long _compare_;
+  btreeptr_t node = *root;
+
+  while (1) {
+    if (nullptr == node->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    _compare_ = cmp(data, node->data, arena->size);
+    if (0 == _compare_)
+      return EXIT_SUCCESS;
+
+    if (_compare_ > 0) {
+      if (nullptr == node->right)
+        return ainitbtree(arena, &(node->right), data);
+      node = node->right;
     } else {
-      arr[0]->left = arr[1];
-      arr[0]->right = nullptr;
+      if (nullptr == node->left)
+        return ainitbtree(arena, &(node->left), data);
+      node = node->left;
     }
-    return arr[0];
-  default:
-
-    /*
-     *  o o o
-     *  o o o o
-     *  o o o o o o o o
-     */
-    arr[len / 2]->left = __frehashbtree(arr, len / 2);
-    arr[len / 2]->right = __frehashbtree(arr + len / 2 + 1, len - len / 2 - 1);
-    return arr[len / 2];
   }
-  return nullptr;
+}
+
+// Igual que insbtree, usa memcmp
+err_t ainsbtree(btarenaptr_t arena, btreeptr_t *const root, const void *data) {
+
+  if (nullptr == arena || nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (nullptr == *root)
+    return ainitbtree(arena, root, data);
+
+  int _compare_;
+  btreeptr_t node = *root;
+
+  while (1) {
+    if (nullptr == node->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    _compare_ = __builtin_memcmp(data, node->data, arena->size);
+    if (0 == _compare_)
+      return EXIT_SUCCESS_REPEATED;
+
+    if (_compare_ > 0) {
+      if (nullptr == node->right)
+        return ainitbtree(arena, &(node->right), data);
+      node = node->right;
+    } else {
+      if (nullptr == node->left)
+        return ainitbtree(arena, &(node->left), data);
+      node = node->left;
+    }
+  }
+}
+
+// Libera todos los nodos de la arena de una, y la arena misma.
+// Como freebtree, si arena es nullptr no hace nada
+void freebtarena(btarenaptr_t *arena) {
+  if (nullptr == arena || nullptr == *arena)
+    return;
+
+  btslab_t *slab = (*arena)->slab, *aux;
+  while (slab) {
+    aux = slab->next;
+    free(slab);
+    slab = aux;
+  }
+
+  free(*arena);
+  *arena = nullptr;
+}
+
+// Une los nodos [0, len) (contiguos, en orden, separados por stride) como
+// un árbol perfectamente balanceado. Recursión de profundidad log2(len)
+static btreeptr_t __buildbtree(char *base, const size_t stride, size_t len) {
+  if (0 == len)
+    return nullptr;
+
+  btreeptr_t node = (btreeptr_t)(base + len / 2 * stride);
+  node->left = __buildbtree(base, stride, len / 2);
+  node->right =
+      __buildbtree(base + (len / 2 + 1) * stride, stride, len - len / 2 - 1);
+  return node;
+}
+
+/*
+ * Equivalente a initarrl, para árboles:
+ * Arma un árbol perfectamente balanceado desde un arreglo ordenado, en O(n).
+ * Los nodos salen de una arena nueva (*arena) con un solo slab, así que
+ * quedan contiguos y en orden. Se libera con freebtarena(...) y se puede
+ * seguir insertando con ainsbtree/afinsbtree.
+ *
+ * cmp nullptr indica orden de memcmp (el de insbtree), si no el de cmp (el
+ * de frehashbtree). Con sort distinto de 0 primero se ordena init_data en el
+ * lugar con qsort; si no, se confía en que ya está ordenado.
+ * Los repetidos se guardan una sola vez, como en insbtree.
+ */
+err_t initarrbtree(btarenaptr_t *const arena, btreeptr_t *const root,
+                   void *init_data, const size_t nmemb, const size_t size,
+                   int (*cmp)(const void *, const void *), const int sort) {
+  if (nullptr == arena || nullptr == root || nullptr == init_data ||
+      0 == nmemb || 0 == size || (sort && nullptr == cmp))
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (sort)
+    qsort(init_data, nmemb, size, cmp);
+
+  if (EXIT_SUCCESS != initbtarena(arena, size, nmemb))
+    return EXIT_FAILURE;
+
+  btslab_t *slab = (*arena)->slab;
+  const size_t stride = (*arena)->stride;
+  const char *data = (const char *)init_data, *last = nullptr;
+  btreeptr_t node;
+
+  for (size_t i = 0; i < nmemb; ++i, data += size) {
+    if (last && 0 == (cmp ? cmp(data, last) : memcmp(data, last, size)))
+      continue;
+
+    node = (btreeptr_t)(slab->mem + stride * slab->used++);
+    node->data = (char *)node + sizeof(btree_t);
+    memcpy(node->data, data, size);
+    last = data;
+  }
+  (*arena)->bytes += stride * slab->used;
+
+  *root = __buildbtree(slab->mem, stride, slab->used);
+  return EXIT_SUCCESS;
+}
+
+// uses memcmp
+// Stores node address to *ret
+err_t findbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret) {
+
+  if (nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  STAT_SCOPE(STATS_BTREE_FIND);
+  int _compare_;
+  btreeptr_t node = root;
+
+  while (1) {
+    if (nullptr == node->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    STAT_VISIT();
+    STAT_COMPARE();
+    _compare_ = __builtin_memcmp(data, node->data, size);
+    if (0 == _compare_) {
+      *ret = node;
+      return EXIT_SUCCESS;
+    }
+
+    if (_compare_ > 0) {
+      if (nullptr == node->right)
+        return EXIT_FAILURE_NOT_FOUND;
+      node = node->right;
+    } else {
+      if (nullptr == node->left)
+        return EXIT_FAILURE_NOT_FOUND;
+
+      node = node->left;
+    }
+  }
+}
+
+err_t ffindbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret,
+                 long (*cmp)(const void *, const void *, size_t size)) {
+
+  if (nullptr == root || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  STAT_SCOPE(STATS_BTREE_FIND);
+  int _compare_;
+  btreeptr_t node = root;
+
+  while (1) {
+    if (nullptr == node->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    STAT_VISIT();
+    STAT_COMPARE();
+    _compare_ = cmp(data, node->data, size);
+    if (0 == _compare_) {
+      *ret = node;
+      return EXIT_SUCCESS;
+    }
+
+    if (_compare_ > 0) {
+      if (nullptr == node->right)
+        return EXIT_FAILURE_NOT_FOUND;
+      node = node->right;
+
+    } else {
+      if (nullptr == node->left)
+        return EXIT_FAILURE_NOT_FOUND;
+
+      node = node->left;
+    }
+  }
+}
+
+/*
+ * Búsquedas por orden:
+ * lower  primer nodo >= data (el "ceiling")
+ * upper  primer nodo >  data
+ * floor  último nodo <= data
+ * Una sola bajada desde la raíz, O(altura). Si no hay tal nodo retornan
+ * EXIT_FAILURE_NOT_FOUND y dejan *ret sin cambios.
+ * Las que empiezan con f usan una función de comparación, como ffindbtree.
+ */
+enum { __BTREE_LOWER, __BTREE_UPPER, __BTREE_FLOOR };
+
+static err_t __boundbtree(btreeptr_t node, const void *data, const size_t size,
+                          btreeptr_t *ret, const int mode,
+                          long (*cmp)(const void *, const void *, size_t)) {
+  if (nullptr == data || nullptr == ret)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  btreeptr_t best = nullptr;
+  long _compare_;
+  int take;
+
+  while (node) {
+    if (nullptr == node->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    _compare_ = cmp ? cmp(data, node->data, size)
+                    : __builtin_memcmp(data, node->data, size);
+
+    switch (mode) {
+    case __BTREE_LOWER:
+      take = _compare_ <= 0;
+      break;
+    case __BTREE_UPPER:
+      take = _compare_ < 0;
+      break;
+    default:
+      take = _compare_ >= 0;
+      break;
+    }
+
+    if (take)
+      best = node;
+
+    // lower/upper: si sirve, buscar uno menor; floor: uno mayor
+    if (take == (__BTREE_FLOOR == mode))
+      node = node->right;
+    else
+      node = node->left;
+  }
+
+  if (nullptr == best)
+    return EXIT_FAILURE_NOT_FOUND;
+
+  *ret = best;
+  return EXIT_SUCCESS;
+}
+
+err_t lowerbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret) {
+  return __boundbtree(root, data, size, ret, __BTREE_LOWER, nullptr);
+}
+
+err_t upperbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret) {
+  return __boundbtree(root, data, size, ret, __BTREE_UPPER, nullptr);
+}
+
+err_t floorbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret) {
+  return __boundbtree(root, data, size, ret, __BTREE_FLOOR, nullptr);
+}
+
+// El ceiling es el lower_bound
+err_t ceilbtree(btreeptr_t root, const void *data, const size_t size,
+                btreeptr_t *ret) {
+  return __boundbtree(root, data, size, ret, __BTREE_LOWER, nullptr);
+}
+
+err_t flowerbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __boundbtree(root, data, size, ret, __BTREE_LOWER, cmp);
+}
+
+err_t fupperbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __boundbtree(root, data, size, ret, __BTREE_UPPER, cmp);
+}
+
+err_t ffloorbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __boundbtree(root, data, size, ret, __BTREE_FLOOR, cmp);
+}
+
+err_t fceilbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret,
+                 long (*cmp)(const void *, const void *, size_t size)) {
+  return flowerbtree(root, data, size, ret, cmp);
+}
+
+// Estado de rangebtree/frangebtree
+typedef struct {
+  const void *lo, *hi;
+  size_t size;
+  long (*cmp)(const void *, const void *, size_t);
+  int (*fn)(btreeptr_t node, void *arg);
+  void *arg;
+} __rangebtree_t;
+
+// Como __flatbtree, pero sin bajar a las ramas que quedan fuera del rango.
+// Sin recursión: los nodos en rango que esperan a su rama izquierda van en
+// la pila de un btcursor_t. Retorna distinto de 0 si hay que cortar: 1 si
+// lo pidió fn, -1 si hay un nodo sin data, -2 sin memoria para la pila
+static int __rangebtree(btreeptr_t node, __rangebtree_t *st) {
+  btcursor_t stack;
+  long _compare_;
+  int stop = 0;
+
+  __resetbtree(&stack);
+  while (!stop) {
+    while (node) {
+      if (nullptr == node->data) {
+        stop = -1;
+        break;
+      }
+
+      // Si node < lo, toda la rama izquierda también
+      _compare_ = st->cmp ? st->cmp(node->data, st->lo, st->size)
+                          : __builtin_memcmp(node->data, st->lo, st->size);
+      if (_compare_ < 0) {
+        node = node->right;
+        continue;
+      }
+
+      // Si node > hi, toda la rama derecha también
+      _compare_ = st->cmp ? st->cmp(node->data, st->hi, st->size)
+                          : __builtin_memcmp(node->data, st->hi, st->size);
+      if (_compare_ > 0) {
+        node = node->left;
+        continue;
+      }
+
+      if (EXIT_SUCCESS != __pushbtree(&stack, node)) {
+        stop = -2;
+        break;
+      }
+      node = node->left;
+    }
+    if (stop || 0 == stack.top)
+      break;
+
+    node = __popbtree(&stack);
+    if (st->fn(node, st->arg))
+      stop = 1;
+    node = node->right;
+  }
+
+  endbtree(&stack);
+  return stop;
+}
+
+static inline err_t __rangeerr(int stop) {
+  if (-1 == stop)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return -2 == stop ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * Llama a fn(nodo, arg) en orden para cada nodo con lo <= dato <= hi, en
+ * O(altura + k). Si fn retorna distinto de 0 se corta el recorrido.
+ * fn no debe modificar el árbol. EXIT_FAILURE solo si el árbol es más alto
+ * que BTREE_MAX_HEIGHT y no hubo memoria para la pila.
+ */
+err_t rangebtree(btreeptr_t root, const void *lo, const void *hi,
+                 const size_t size, int (*fn)(btreeptr_t node, void *arg),
+                 void *arg) {
+  if (nullptr == lo || nullptr == hi || nullptr == fn)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __rangebtree_t st = {lo, hi, size, nullptr, fn, arg};
+  return __rangeerr(__rangebtree(root, &st));
+}
+
+err_t frangebtree(btreeptr_t root, const void *lo, const void *hi,
+                  const size_t size, int (*fn)(btreeptr_t node, void *arg),
+                  void *arg,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == lo || nullptr == hi || nullptr == fn || nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __rangebtree_t st = {lo, hi, size, cmp, fn, arg};
+  return __rangeerr(__rangebtree(root, &st));
+}
+
+/*
+ * Búsqueda por lotes:
+ * En lugar de buscar una clave hasta el final y recién ahí la siguiente,
+ * se avanzan BTREE_BATCH búsquedas a la vez, un paso cada una por turno.
+ * Cada paso pide por adelantado (__builtin_prefetch) lo que la misma
+ * búsqueda va a leer en su próximo turno, así mientras llega de memoria se
+ * trabaja en las otras. Cada nivel tiene dos pasos: primero el nodo (para
+ * poder leer node->data) y después la comparación.
+ */
+#ifndef BTREE_BATCH
+#define BTREE_BATCH 16
+#endif
+
+typedef struct {
+  btreeptr_t node;
+  size_t i;  // Índice de la clave
+  int stage; // 0: pedir node->data, 1: comparar
+} __mfind_t;
+
+static err_t __mfindbtree(btreeptr_t root, const void *data, const size_t size,
+                          const size_t nmemb, btreeptr_t *ret, err_t *err,
+                          long (*cmp)(const void *, const void *, size_t)) {
+  if (nullptr == root || nullptr == data || nullptr == ret || nullptr == err)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __mfind_t lanes[BTREE_BATCH], *lane;
+  size_t active, next, l;
+  err_t all = EXIT_SUCCESS;
+  const char *key;
+  long _compare_;
+
+  for (active = 0; active < BTREE_BATCH && active < nmemb; ++active) {
+    lanes[active].node = root;
+    lanes[active].i = active;
+    lanes[active].stage = 0;
+  }
+  next = active;
+
+  while (active) {
+    for (l = 0; l < active;) {
+      lane = lanes + l;
+
+      if (0 == lane->stage) {
+        if (nullptr == lane->node->data) {
+          ret[lane->i] = nullptr;
+          err[lane->i] = all = EXIT_FAILURE_IMPROPER_USE;
+          goto done;
+        }
+        __builtin_prefetch(lane->node->data);
+        lane->stage = 1;
+        ++l;
+        continue;
+      }
+
+      key = (const char *)data + lane->i * size;
+      _compare_ = cmp ? cmp(key, lane->node->data, size)
+                      : __builtin_memcmp(key, lane->node->data, size);
+
+      if (0 == _compare_) {
+        ret[lane->i] = lane->node;
+        err[lane->i] = EXIT_SUCCESS;
+        goto done;
+      }
+
+      lane->node = _compare_ > 0 ? lane->node->right : lane->node->left;
+      if (nullptr == lane->node) {
+        ret[lane->i] = nullptr;
+        err[lane->i] = EXIT_FAILURE_NOT_FOUND;
+        if (EXIT_SUCCESS == all)
+          all = EXIT_FAILURE_NOT_FOUND;
+        goto done;
+      }
+
+      __builtin_prefetch(lane->node);
+      lane->stage = 0;
+      ++l;
+      continue;
+
+    done:
+      // La búsqueda terminó: toma la siguiente clave o se saca del lote
+      if (next < nmemb) {
+        lane->node = root;
+        lane->i = next++;
+        lane->stage = 0;
+        ++l;
+      } else {
+        *lane = lanes[--active];
+      }
+    }
+  }
+
+  return all;
+}
+
+// Busca las nmemb claves contiguas de data (de size bytes cada una) con
+// memcmp. ret[i] y err[i] son lo que findbtree hubiera dado para la clave i
+// (ret[i] es nullptr si no está). Retorna EXIT_SUCCESS si estaban todas.
+err_t mfindbtree(btreeptr_t root, const void *data, const size_t size,
+                 const size_t nmemb, btreeptr_t *ret, err_t *err) {
+  return __mfindbtree(root, data, size, nmemb, ret, err, nullptr);
+}
+
+// Igual que mfindbtree, con función de comparación como ffindbtree
+err_t mffindbtree(btreeptr_t root, const void *data, const size_t size,
+                  const size_t nmemb, btreeptr_t *ret, err_t *err,
+                  long (*cmp)(const void *, const void *, size_t size)) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __mfindbtree(root, data, size, nmemb, ret, err, cmp);
+}
+
+// Estado del recorrido en orden de arrbtree/nodearrbtree y sus variantes
+// con buffer del llamador
+typedef struct {
+  void **dst;
+  size_t len, cap;
+  int grow;  // dst se puede agrandar con realloc
+  int nodes; // Guardar punteros a nodos en lugar de punteros a data
+} __flatbtree_t;
+
+// En orden con un btcursor_t (sin recursión, la altura no importa).
+// Si dst no se puede agrandar sigue contando, para decir cuánto hacía falta.
+// EXIT_FAILURE_IMPROPER_USE si hay un nodo sin data, EXIT_FAILURE sin memoria
+static err_t __flatbtree(btreeptr_t node, __flatbtree_t *st) {
+  btcursor_t it;
+  err_t e;
+
+  for (e = beginbtree(&it, node); !e; e = nextbtree(&it)) {
+    if (nullptr == it.node->data) {
+      endbtree(&it);
+      return EXIT_FAILURE_IMPROPER_USE;
+    }
+
+    if (st->len == st->cap && st->grow) {
+      size_t cap = st->cap ? 2 * st->cap : 64;
+      void **aux = (void **)realloc(st->dst, cap * sizeof(void *));
+      if (nullptr == aux) {
+        endbtree(&it);
+        return EXIT_FAILURE;
+      }
+      st->dst = aux;
+      st->cap = cap;
+    }
+    if (st->len < st->cap)
+      st->dst[st->len] = st->nodes ? (void *)it.node : it.node->data;
+    ++st->len;
+  }
+
+  return EXIT_FAILURE_NOT_FOUND == e ? EXIT_SUCCESS : e;
+}
+
+// Transforma dst en un arreglo de punteros a los datos del árbol binario.
+// Es fácil acceder a los punteros que apuntan a las ramaas inferiores del
+// árbol, simplemete hay que mirar cómo está declarada la estructura
+// Una sola pasada en orden, escribiendo directo en *dst (que crece al doble
+// cuando se llena), sin lista intermedia.
+err_t arrbtree(void **dst, btreeptr_t node, size_t *len) {
+  __flatbtree_t st = {nullptr, 0, 0, 1, 0};
+
+  if (EXIT_SUCCESS != __flatbtree(node, &st)) {
+    free(st.dst);
+    *dst = nullptr;
+    return EXIT_FAILURE;
+  }
+
+  *dst = st.dst;
+  *len = st.len;
+  return EXIT_SUCCESS;
+}
+
+// Mismo que arrbtree, pero retorna punteros a los nodos en lugar de los datos
+err_t nodearrbtree(btreeptr_t **dst, btreeptr_t node, size_t *len) {
+  __flatbtree_t st = {nullptr, 0, 0, 1, 1};
+
+  if (EXIT_SUCCESS != __flatbtree(node, &st)) {
+    free(st.dst);
+    *dst = nullptr;
+    return EXIT_FAILURE;
+  }
+
+  *dst = (btreeptr_t *)st.dst;
+  *len = st.len;
+  return EXIT_SUCCESS;
+}
+
+// Igual que arrbtree, pero dst lo da el llamador con lugar para cap punteros:
+// no aloja nada (salvo la pila del cursor si el árbol tiene más de
+// BTREE_MAX_HEIGHT niveles). Si el árbol tiene más de cap nodos llena los
+// primeros cap, guarda en *len la cantidad que hacía falta y retorna
+// EXIT_FAILURE. Sin memoria para la pila, EXIT_FAILURE con *len en 0.
+err_t barrbtree(void **dst, const size_t cap, btreeptr_t node, size_t *len) {
+  __flatbtree_t st = {dst, 0, cap, 0, 0};
+  err_t e = __flatbtree(node, &st);
+
+  if (EXIT_FAILURE == e)
+    *len = 0;
+  if (EXIT_SUCCESS != e)
+    return e;
+
+  *len = st.len;
+  return st.len > cap ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Igual que barrbtree, pero con punteros a los nodos
+err_t bnodearrbtree(btreeptr_t *dst, const size_t cap, btreeptr_t node,
+                    size_t *len) {
+  __flatbtree_t st = {(void **)dst, 0, cap, 0, 1};
+  err_t e = __flatbtree(node, &st);
+
+  if (EXIT_FAILURE == e)
+    *len = 0;
+  if (EXIT_SUCCESS != e)
+    return e;
+
+  *len = st.len;
+  return st.len > cap ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Makes the binary tree faster after processing it
+// cmp viaja como parámetro (y no en una variable global) para que dos hilos
+// puedan rebalancear árboles distintos a la vez
+static inline btreeptr_t __frehashbtree(btreeptr_t *arr, size_t len,
+                                        int (*cmp)(const void *,
+                                                   const void *)) {
+  switch (len) {
+    // case 0 is nearly never reachen, unless the programmer calls the function
+    // with it
+  case 0:
+    return nullptr;
+  case 1:
+    // Make sure that left and right pointers are null, othercase we will
+    // destroy our computer
+    (*arr)->right = nullptr;
+    (*arr)->left = nullptr;
+    return *arr;
+  case 2:
+    // Same as case 1, for the node that hangs
+    arr[1]->right = nullptr;
+    arr[1]->left = nullptr;
+    if (cmp((arr[1])->data, (arr[0])->data) > 0) {
+      arr[0]->right = arr[1];
+      arr[0]->left = nullptr;
+    } else {
+      arr[0]->left = arr[1];
+      arr[0]->right = nullptr;
+    }
+    return arr[0];
+  default:
+
+    /*
+     *  o o o
+     *  o o o o
+     *  o o o o o o o o
+     */
+    arr[len / 2]->left = __frehashbtree(arr, len / 2, cmp);
+    arr[len / 2]->right =
+        __frehashbtree(arr + len / 2 + 1, len - len / 2 - 1, cmp);
+    return arr[len / 2];
+  }
+  return nullptr;
 }
 
 err_t frehashbtree(btreeptr_t *root, int (*comp)(const void *, const void *)) {
   btreeptr_t *arr;
   size_t len;
-  __frehashbtree_cmp = comp;
-  nodearrbtree(&arr, *root, &len);
-  *root = __frehashbtree(arr, len);
+  if (EXIT_SUCCESS != nodearrbtree(&arr, *root, &len))
+    return EXIT_FAILURE;
+  *root = __frehashbtree(arr, len, comp);
+  free(arr);
+  return EXIT_SUCCESS;
+}
+
+// Después de reconstruir el árbol queda balanceado, la recursión es corta
+static void __avlrecompute(btreeptr_t node) {
+  if (nullptr == node)
+    return;
+  __avlrecompute(node->left);
+  __avlrecompute(node->right);
+  __avlfix(node);
+}
+
+// frehashbtree para árboles AVL: además recalcula alturas y tamaños.
+// Un árbol perfectamente balanceado también es AVL
+err_t avlfrehashbtree(btreeptr_t *root,
+                      int (*comp)(const void *, const void *)) {
+  if (EXIT_SUCCESS != frehashbtree(root, comp))
+    return EXIT_FAILURE;
+  __avlrecompute(*root);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Rebalanceo en el lugar (Day-Stout-Warren):
+ * Con rotaciones, primero se estira el árbol en una "enredadera" (lista
+ * ordenada por ->right) y después se la comprime en un árbol completo.
+ * No aloja nada y usa memoria extra constante, a cambio de recorrer el árbol
+ * unas log2(n) veces. La altura queda igual a la de frehashbtree (mínima),
+ * pero el último nivel se llena de izquierda a derecha.
+ * No necesita comparación: las rotaciones no cambian el orden.
+ */
+
+// pseudo->right es la raíz. Retorna la cantidad de nodos
+static size_t __dswvine(btreeptr_t pseudo) {
+  btreeptr_t tail = pseudo, rest = pseudo->right, aux;
+  size_t len = 0;
+
+  while (rest) {
+    if (nullptr == rest->left) {
+      tail = rest;
+      rest = rest->right;
+      ++len;
+    } else {
+      // Rotación a la derecha
+      aux = rest->left;
+      rest->left = aux->right;
+      aux->right = rest;
+      rest = aux;
+      tail->right = aux;
+    }
+  }
+
+  return len;
+}
+
+// count rotaciones a la izquierda, una sí y una no, a lo largo de la rama
+static void __dswcompress(btreeptr_t pseudo, size_t count) {
+  btreeptr_t scanner = pseudo, child;
+
+  while (count--) {
+    child = scanner->right;
+    scanner->right = child->right;
+    scanner = scanner->right;
+    child->right = scanner->left;
+    scanner->left = child;
+  }
+}
+
+err_t ifrehashbtree(btreeptr_t *root) {
+  if (nullptr == root)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  btree_t pseudo; // Raíz falsa, para no tratar aparte a la raíz verdadera
+  pseudo.left = nullptr;
+  pseudo.right = *root;
+
+  size_t len = __dswvine(&pseudo), full = 1;
+
+  // full = 2^floor(log2(len + 1)), lo que entra en niveles completos
+  while (full <= (len + 1) / 2)
+    full *= 2;
+
+  __dswcompress(&pseudo, len + 1 - full);
+  for (len = full - 1; len > 1; len /= 2)
+    __dswcompress(&pseudo, len / 2);
+
+  *root = pseudo.right;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Forma del árbol:
+ * shapebtree recorre todo el árbol (O(n), con una pila propia, así que sirve
+ * aunque esté degenerado) y da la altura, la cantidad de nodos y la
+ * profundidad promedio (la raíz está a profundidad 1: es lo que cuesta en
+ * promedio una búsqueda exitosa). imbalance es la altura dividida por la
+ * mínima posible para esa cantidad de nodos: 1 es perfecto.
+ */
+typedef struct {
+  size_t height, size;
+  double depth;
+  double imbalance;
+} btshape_t;
+
+// Altura mínima de un árbol de n nodos
+#define __optheight(n) ((n) ? 64 - __builtin_clzll((unsigned long long)(n)) : 0)
+
+err_t shapebtree(btreeptr_t root, btshape_t *shape) {
+  if (nullptr == shape)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  typedef struct {
+    btreeptr_t node;
+    size_t depth;
+  } item_t;
+
+  item_t *stack = nullptr, *aux;
+  size_t top = 0, cap = 0, total = 0;
+
+  memset(shape, 0, sizeof(btshape_t));
+  if (root) {
+    if (nullptr == (stack = (item_t *)malloc(64 * sizeof(item_t))))
+      return EXIT_FAILURE;
+    cap = 64;
+    stack[top++] = (item_t){root, 1};
+  }
+
+  while (top) {
+    item_t it = stack[--top];
+    ++shape->size;
+    total += it.depth;
+    if (it.depth > shape->height)
+      shape->height = it.depth;
+
+    // Hay lugar para los dos hijos
+    if (top + 2 > cap) {
+      aux = (item_t *)realloc(stack, 2 * cap * sizeof(item_t));
+      if (nullptr == aux) {
+        free(stack);
+        return EXIT_FAILURE;
+      }
+      stack = aux;
+      cap *= 2;
+    }
+    if (it.node->right)
+      stack[top++] = (item_t){it.node->right, it.depth + 1};
+    if (it.node->left)
+      stack[top++] = (item_t){it.node->left, it.depth + 1};
+  }
+
+  if (shape->size) {
+    shape->depth = (double)total / shape->size;
+    shape->imbalance = (double)shape->height / __optheight(shape->size);
+  }
+  free(stack);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Rebalanceo automático:
+ * En vez de llamar a frehashbtree a ciegas cada tanto, rinsbtree/rfinsbtree
+ * insertan igual que insbtree/finsbtree y miran la profundidad a la que
+ * quedó el nodo nuevo. Si pasa de threshold veces la altura mínima del
+ * árbol, suben por el camino contando nodos hasta el primer subárbol
+ * desbalanceado en peso (un hijo con más de alpha de los nodos, alpha sale
+ * de threshold) y rebalancean solo ese subárbol, como un scapegoat tree:
+ * O(log n) amortizado por inserción, aun con claves ordenadas.
+ *
+ * Si el camino es más largo que BTREE_POLICY_DEPTH (un árbol que ya venía
+ * degenerado) se rebalancea el árbol entero, a lo sumo una vez cada size / 4
+ * inserciones.
+ *
+ * rebalancebtree es lo mismo a pedido, midiendo con shapebtree: el que lo
+ * llamaba con un timer ahora solo paga el rebalanceo si hace falta.
+ *
+ * Si comp es nullptr se usa ifrehashbtree (no necesita comparar ni pedir
+ * memoria), si no frehashbtree(root, comp).
+ */
+#ifndef BTREE_POLICY_DEPTH
+#define BTREE_POLICY_DEPTH 256
+#endif
+
+typedef struct {
+  double threshold; // 2 es un buen valor
+  double alpha;     // Peso máximo de un hijo, 1 - ln(2) / threshold
+  size_t min;       // Con menos nodos nunca se rebalancea
+  int (*comp)(const void *, const void *);
+  size_t size;     // Nodos del árbol, lo llevan rinsbtree/rfinsbtree
+  size_t since;    // Inserciones desde el último rebalanceo entero
+  size_t rebuilds; // Cuántas veces se rebalanceó (algún subárbol)
+} btpolicy_t;
+
+// root es el árbol que se va a usar (puede ser nullptr), se cuenta una vez
+err_t initbtpolicy(btpolicy_t *policy, btreeptr_t root, const double threshold,
+                   const size_t min, int (*comp)(const void *, const void *)) {
+  btshape_t shape;
+
+  if (nullptr == policy || threshold < 1)
+    return EXIT_FAILURE_IMPROPER_USE;
+  if (EXIT_SUCCESS != shapebtree(root, &shape))
+    return EXIT_FAILURE;
+
+  // 1 - ln(2) / t <= 2^(-1 / t): si la profundidad pasa de t * log2(n),
+  // algún subárbol del camino está desbalanceado con este alpha
+  policy->threshold = threshold;
+  policy->alpha = 1 - 0.6931471805599453 / threshold;
+  policy->min = min;
+  policy->comp = comp;
+  policy->size = shape.size;
+  policy->since = 0;
+  policy->rebuilds = 0;
+  return EXIT_SUCCESS;
+}
+
+// Cantidad de nodos, con Morris: sin memoria extra y deja el árbol igual
+static size_t __countbtree(btreeptr_t node) {
+  size_t count = 0;
+  btreeptr_t pre;
+
+  while (node) {
+    if (nullptr == node->left) {
+      ++count;
+      node = node->right;
+      continue;
+    }
+    for (pre = node->left; pre->right && pre->right != node; pre = pre->right)
+      ;
+    if (nullptr == pre->right) {
+      pre->right = node;
+      node = node->left;
+    } else {
+      pre->right = nullptr;
+      ++count;
+      node = node->right;
+    }
+  }
+  return count;
+}
+
+static inline err_t __rebuildbtree(btreeptr_t *link, btpolicy_t *policy) {
+  err_t ret = policy->comp ? frehashbtree(link, policy->comp)
+                           : ifrehashbtree(link);
+  if (EXIT_SUCCESS == ret)
+    ++policy->rebuilds;
+  return ret;
+}
+
+static err_t __rinsbtree(btreeptr_t *const root, const void *data,
+                         const size_t size,
+                         long (*cmp)(const void *, const void *, size_t),
+                         btpolicy_t *policy) {
+  if (nullptr == root || nullptr == data || nullptr == policy)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  STAT_SCOPE(STATS_BTREE_INSERT);
+  btreeptr_t *path[BTREE_POLICY_DEPTH];
+  btreeptr_t *link = root, child, node;
+  size_t depth = 0, sub, total;
+  long _compare_;
+
+  while (*link) {
+    if (nullptr == (*link)->data)
+      return EXIT_FAILURE_IMPROPER_USE;
+
+    STAT_VISIT();
+    STAT_COMPARE();
+    _compare_ = cmp ? cmp(data, (*link)->data, size)
+                    : __builtin_memcmp(data, (*link)->data, size);
+    if (0 == _compare_)
+      return cmp ? EXIT_SUCCESS : EXIT_SUCCESS_REPEATED;
+
+    if (depth < BTREE_POLICY_DEPTH)
+      path[depth] = link;
+    ++depth;
+    link = _compare_ > 0 ? &((*link)->right) : &((*link)->left);
+  }
+
+  if (EXIT_SUCCESS != initbtree(link, data, size))
+    return EXIT_FAILURE;
+
+  ++policy->size;
+  ++policy->since;
+  if (policy->size < policy->min ||
+      depth + 1 <= policy->threshold * __optheight(policy->size))
+    return EXIT_SUCCESS;
+
+  // Busca el subárbol desbalanceado más bajo del camino
+  if (depth <= BTREE_POLICY_DEPTH) {
+    child = *link;
+    sub = 1;
+    while (depth--) {
+      node = *path[depth];
+      total = sub + 1 +
+              __countbtree(node->left == child ? node->right : node->left);
+      if (sub > policy->alpha * total) {
+        __rebuildbtree(path[depth], policy);
+        return EXIT_SUCCESS;
+      }
+      sub = total;
+      child = node;
+    }
+  }
+
+  if (4 * policy->since >= policy->size &&
+      EXIT_SUCCESS == __rebuildbtree(root, policy))
+    policy->since = 0;
+  return EXIT_SUCCESS;
+}
+
+// insbtree + rebalanceo automático
+err_t rinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                btpolicy_t *policy) {
+  return __rinsbtree(root, data, size, nullptr, policy);
+}
+
+// finsbtree + rebalanceo automático
+err_t rfinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size),
+                 btpolicy_t *policy) {
+  if (nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+  return __rinsbtree(root, data, size, cmp, policy);
+}
+
+// Mide el árbol y lo rebalancea si imbalance pasa de policy->threshold.
+// EXIT_SUCCESS_REPEATED si no hizo falta
+err_t rebalancebtree(btreeptr_t *root, btpolicy_t *policy) {
+  btshape_t shape;
+
+  if (nullptr == root || nullptr == policy)
+    return EXIT_FAILURE_IMPROPER_USE;
+  if (EXIT_SUCCESS != shapebtree(*root, &shape))
+    return EXIT_FAILURE;
+
+  policy->size = shape.size;
+  if (shape.size < policy->min || shape.imbalance <= policy->threshold)
+    return EXIT_SUCCESS_REPEATED;
+
+  if (EXIT_SUCCESS != __rebuildbtree(root, policy))
+    return EXIT_FAILURE;
+  policy->since = 0;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Modo paralelo:
+ * Los primeros niveles del árbol (o del arreglo, al reconstruir) se parten
+ * en muchas más tareas que hilos, y cada hilo va tomando la siguiente tarea
+ * libre. El hilo que llama también trabaja. Si no se puede crear algún
+ * hilo, el resto del trabajo lo hacen los que sí se crearon.
+ */
+#ifndef BTREE_MAX_THREADS
+#define BTREE_MAX_THREADS 64
+#endif
+
+// Con 4 tareas por hilo: 2^8 subárboles + 2^8 - 1 nodos sueltos a lo sumo
+#define __BTREE_MAX_TASKS 512
+
+typedef struct {
+  void (*fn)(void *tasks, size_t i);
+  void *tasks;
+  size_t ntasks;
+  size_t next; // Siguiente tarea libre, se toma con __atomic_fetch_add
+} __btpool_t;
+
+static void *__btpool_worker(void *arg) {
+  __btpool_t *pool = (__btpool_t *)arg;
+  size_t i;
+
+  while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+         pool->ntasks)
+    pool->fn(pool->tasks, i);
+
+  return nullptr;
+}
+
+static void __btpool_run(unsigned threads, void (*fn)(void *, size_t),
+                         void *tasks, size_t ntasks) {
+  pthread_t tid[BTREE_MAX_THREADS];
+  __btpool_t pool = {fn, tasks, ntasks, 0};
+  unsigned i, spawned = 0;
+
+  for (i = 1; i < threads; ++i) {
+    if (pthread_create(tid + spawned, nullptr, __btpool_worker, &pool))
+      break;
+    ++spawned;
+  }
+
+  __btpool_worker(&pool);
+
+  for (i = 0; i < spawned; ++i)
+    pthread_join(tid[i], nullptr);
+}
+
+static inline unsigned __btpool_depth(unsigned *threads) {
+  if (0 == *threads)
+    *threads = 1;
+  if (*threads > BTREE_MAX_THREADS)
+    *threads = BTREE_MAX_THREADS;
+
+  unsigned depth = 0;
+  while ((1u << depth) < 4 * *threads)
+    ++depth;
+  return depth;
+}
+
+// Tarea de aplanado: un subárbol entero o un nodo suelto entre subárboles
+typedef struct {
+  btreeptr_t node;
+  void **dst;
+  size_t off, len;
+  int single;
+  int nodes;
+  err_t err;
+} __pflat_t;
+
+static size_t __psplitbtree(btreeptr_t node, unsigned depth, __pflat_t *tasks,
+                            size_t n) {
+  if (nullptr == node)
+    return n;
+
+  if (0 == depth) {
+    tasks[n].node = node;
+    tasks[n].single = 0;
+    return n + 1;
+  }
+
+  n = __psplitbtree(node->left, depth - 1, tasks, n);
+  tasks[n].node = node;
+  tasks[n].single = 1;
+  return __psplitbtree(node->right, depth - 1, tasks, n + 1);
+}
+
+// Primera pasada: cuántos nodos tiene cada tarea
+static void __pflatcount(void *tasks, size_t i) {
+  __pflat_t *task = (__pflat_t *)tasks + i;
+
+  if (task->single) {
+    task->len = 1;
+    task->err = nullptr == task->node->data ? EXIT_FAILURE : EXIT_SUCCESS;
+    return;
+  }
+
+  __flatbtree_t st = {nullptr, 0, 0, 0, task->nodes};
+  task->err = __flatbtree(task->node, &st);
+  task->len = st.len;
+}
+
+// Segunda pasada: cada tarea escribe en su parte de dst
+static void __pflatfill(void *tasks, size_t i) {
+  __pflat_t *task = (__pflat_t *)tasks + i;
+
+  if (task->single) {
+    task->dst[task->off] =
+        task->nodes ? (void *)task->node : task->node->data;
+    return;
+  }
+
+  __flatbtree_t st = {task->dst + task->off, 0, task->len, 0, task->nodes};
+  task->err = __flatbtree(task->node, &st);
+}
+
+static err_t __pflatten(void ***dst, btreeptr_t node, size_t *len,
+                        unsigned threads, const int nodes) {
+  __pflat_t tasks[__BTREE_MAX_TASKS];
+  size_t ntasks, i, total = 0;
+
+  ntasks = __psplitbtree(node, __btpool_depth(&threads), tasks, 0);
+  for (i = 0; i < ntasks; ++i)
+    tasks[i].nodes = nodes;
+
+  *dst = nullptr;
+  __btpool_run(threads, __pflatcount, tasks, ntasks);
+  for (i = 0; i < ntasks; ++i) {
+    if (EXIT_SUCCESS != tasks[i].err)
+      return EXIT_FAILURE;
+    tasks[i].off = total;
+    total += tasks[i].len;
+  }
+
+  // Árbol vacío: como arrbtree, *dst en nullptr y largo 0
+  *len = 0;
+  if (0 == total)
+    return EXIT_SUCCESS;
+
+  *dst = (void **)malloc(total * sizeof(void *));
+  if (nullptr == *dst)
+    return EXIT_FAILURE;
+  for (i = 0; i < ntasks; ++i)
+    tasks[i].dst = *dst;
+
+  __btpool_run(threads, __pflatfill, tasks, ntasks);
+  for (i = 0; i < ntasks; ++i)
+    if (EXIT_SUCCESS != tasks[i].err) {
+      free(*dst);
+      *dst = nullptr;
+      return EXIT_FAILURE;
+    }
+
+  *len = total;
+  return EXIT_SUCCESS;
+}
+
+// Igual que arrbtree, repartido en threads hilos
+err_t parrbtree(void **dst, btreeptr_t node, size_t *len, unsigned threads) {
+  return __pflatten((void ***)dst, node, len, threads, 0);
+}
+
+// Igual que nodearrbtree, repartido en threads hilos
+err_t pnodearrbtree(btreeptr_t **dst, btreeptr_t node, size_t *len,
+                    unsigned threads) {
+  return __pflatten((void ***)dst, node, len, threads, 1);
+}
+
+// Tarea de reconstrucción: un rango del arreglo, y dónde colgar su raíz
+typedef struct {
+  btreeptr_t *arr;
+  size_t len;
+  btreeptr_t *slot;
+  int (*cmp)(const void *, const void *);
+} __prehash_t;
+
+// Mismo corte que __frehashbtree, así el árbol queda idéntico
+static size_t __psplitrehash(btreeptr_t *arr, size_t len, btreeptr_t *slot,
+                             unsigned depth, __prehash_t *tasks, size_t n) {
+  if (0 == depth || len < 3) {
+    tasks[n].arr = arr;
+    tasks[n].len = len;
+    tasks[n].slot = slot;
+    return n + 1;
+  }
+
+  *slot = arr[len / 2];
+  n = __psplitrehash(arr, len / 2, &(arr[len / 2]->left), depth - 1, tasks,
+                     n);
+  return __psplitrehash(arr + len / 2 + 1, len - len / 2 - 1,
+                        &(arr[len / 2]->right), depth - 1, tasks, n);
+}
+
+static void __prehash(void *tasks, size_t i) {
+  __prehash_t *task = (__prehash_t *)tasks + i;
+  *(task->slot) = __frehashbtree(task->arr, task->len, task->cmp);
+}
+
+// Igual que frehashbtree, aplanando y reconstruyendo en threads hilos
+err_t pfrehashbtree(btreeptr_t *root, int (*comp)(const void *, const void *),
+                    unsigned threads) {
+  __prehash_t tasks[__BTREE_MAX_TASKS];
+  btreeptr_t *arr;
+  size_t len, ntasks, i;
+
+  if (EXIT_SUCCESS != pnodearrbtree(&arr, *root, &len, threads))
+    return EXIT_FAILURE;
+
+  // 2^(depth - 1) rangos, entran de sobra
+  ntasks = __psplitrehash(arr, len, root, __btpool_depth(&threads) - 1, tasks,
+                          0);
+  for (i = 0; i < ntasks; ++i)
+    tasks[i].cmp = comp;
+
+  __btpool_run(threads, __prehash, tasks, ntasks);
+  free(arr);
   return EXIT_SUCCESS;
 }
 
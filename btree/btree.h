@@ -5,15 +5,19 @@
 
 #include "btree.c"
 
+#define BTREE_H
+
 // I managed to not use recursion
 // Create btree
 err_t initbtree(btreeptr_t *const root, const void *data, const size_t size);
 
-// Insert an element with a provided compare function
+// Insert an element with a provided compare function. A key that is already
+// there gives EXIT_SUCCESS (insbtree gives EXIT_SUCCESS_REPEATED)
 err_t finsbtree(btreeptr_t *const root, const void *data, const size_t size,
                 long (*cmp)(const void *mem1, const void *mem2, size_t size));
 
-// Insert an element using __builtin_memcmp for comparision
+// Insert an element using __builtin_memcmp for comparision.
+// EXIT_SUCCESS_REPEATED if it was already there
 err_t insbtree(btreeptr_t *const root, const void *data, const size_t size);
 
 // Find element using __builtin_memcmp for comparision
@@ -22,4 +26,150 @@ err_t findbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret);
 // Find element using a provided function for comparission
 err_t ffindbtree(btreeptr_t root, void *data, size_t size, btreeptr_t *ret,
                  long (*cmp)(const void *, const void *, size_t size));
+
+// Iterative teardown, any height, constant stack. nullptr *root is fine
+void freebtree(btreeptr_t *root);
+
+// In-order cursor with its own stack (on the heap only past
+// BTREE_MAX_HEIGHT). The tree is only read, so searches and other cursors
+// may run meanwhile; do not modify it while the cursor is open. Call
+// endbtree if the walk stops before the end
+err_t beginbtree(btcursor_t *it, btreeptr_t root);
+err_t nextbtree(btcursor_t *it);
+void endbtree(btcursor_t *it);
+
+// Ordered lookups: first >= data (lower, ceil), first > data (upper),
+// last <= data (floor). The f* versions take a comparison function
+err_t lowerbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret);
+err_t upperbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret);
+err_t floorbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret);
+err_t ceilbtree(btreeptr_t root, const void *data, const size_t size,
+                btreeptr_t *ret);
+err_t flowerbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size));
+err_t fupperbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size));
+err_t ffloorbtree(btreeptr_t root, const void *data, const size_t size,
+                  btreeptr_t *ret,
+                  long (*cmp)(const void *, const void *, size_t size));
+err_t fceilbtree(btreeptr_t root, const void *data, const size_t size,
+                 btreeptr_t *ret,
+                 long (*cmp)(const void *, const void *, size_t size));
+
+// Calls fn(node, arg) in order for every lo <= data <= hi, O(height + k).
+// A nonzero return from fn stops the scan
+err_t rangebtree(btreeptr_t root, const void *lo, const void *hi,
+                 const size_t size, int (*fn)(btreeptr_t node, void *arg),
+                 void *arg);
+err_t frangebtree(btreeptr_t root, const void *lo, const void *hi,
+                  const size_t size, int (*fn)(btreeptr_t node, void *arg),
+                  void *arg,
+                  long (*cmp)(const void *, const void *, size_t size));
+
+// Batch lookup of nmemb contiguous keys, interleaving the searches and
+// prefetching. ret[i]/err[i] are what findbtree/ffindbtree give for key i
+err_t mfindbtree(btreeptr_t root, const void *data, const size_t size,
+                 const size_t nmemb, btreeptr_t *ret, err_t *err);
+err_t mffindbtree(btreeptr_t root, const void *data, const size_t size,
+                  const size_t nmemb, btreeptr_t *ret, err_t *err,
+                  long (*cmp)(const void *, const void *, size_t size));
+
+// In-order flattening into a malloc'd array of data (or node) pointers
+err_t arrbtree(void **dst, btreeptr_t node, size_t *len);
+err_t nodearrbtree(btreeptr_t **dst, btreeptr_t node, size_t *len);
+
+// Same, into a caller-provided buffer of cap pointers. No allocation unless
+// the tree is taller than BTREE_MAX_HEIGHT (cursor stack).
+// EXIT_FAILURE if it did not fit, *len is then the needed capacity
+// (0 if the cursor stack could not be allocated)
+err_t barrbtree(void **dst, const size_t cap, btreeptr_t node, size_t *len);
+err_t bnodearrbtree(btreeptr_t *dst, const size_t cap, btreeptr_t node,
+                    size_t *len);
+
+// Rebuild the tree perfectly balanced
+err_t frehashbtree(btreeptr_t *root, int (*comp)(const void *, const void *));
+
+// Same height as frehashbtree, but in place with rotations: no allocation,
+// constant extra memory (Day-Stout-Warren)
+err_t ifrehashbtree(btreeptr_t *root);
+
+// Height, size, average depth and height / minimal height, O(n)
+err_t shapebtree(btreeptr_t root, btshape_t *shape);
+
+// Insert and, once the new node is threshold times deeper than the minimal
+// height, rebalance the unbalanced subtree on its path (scapegoat style).
+// comp nullptr rebalances with ifrehashbtree
+err_t initbtpolicy(btpolicy_t *policy, btreeptr_t root, const double threshold,
+                   const size_t min, int (*comp)(const void *, const void *));
+err_t rinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                btpolicy_t *policy);
+err_t rfinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size),
+                 btpolicy_t *policy);
+
+// Rebalance only if the measured imbalance is over policy->threshold
+err_t rebalancebtree(btreeptr_t *root, btpolicy_t *policy);
+
+// All of the above are reentrant. These split the work across threads
+// (the caller included), link with -pthread
+err_t parrbtree(void **dst, btreeptr_t node, size_t *len, unsigned threads);
+err_t pnodearrbtree(btreeptr_t **dst, btreeptr_t node, size_t *len,
+                    unsigned threads);
+err_t pfrehashbtree(btreeptr_t *root, int (*comp)(const void *, const void *),
+                    unsigned threads);
+
+// Balanced (AVL) insertion. Trees built with these can be searched with
+// findbtree/ffindbtree as usual, but must not be mixed with insbtree/finsbtree
+err_t favlinsbtree(btreeptr_t *const root, const void *data, const size_t size,
+                   long (*cmp)(const void *mem1, const void *mem2,
+                               size_t size));
+err_t avlinsbtree(btreeptr_t *const root, const void *data, const size_t size);
+
+// AVL trees also track subtree sizes: O(1) size, O(log n) rank and select.
+// rank is the number of keys < data; select is 0-based
+size_t avlsizebtree(btreeptr_t root);
+err_t avlrankbtree(btreeptr_t root, const void *data, const size_t size,
+                   size_t *rank);
+err_t favlrankbtree(btreeptr_t root, const void *data, const size_t size,
+                    size_t *rank,
+                    long (*cmp)(const void *, const void *, size_t size));
+err_t avlselectbtree(btreeptr_t root, size_t k, btreeptr_t *ret);
+
+// frehashbtree for AVL trees, keeps heights and sizes right
+err_t avlfrehashbtree(btreeptr_t *root,
+                      int (*comp)(const void *, const void *));
+
+// Delete a key, freeing its node and data. EXIT_FAILURE_NOT_FOUND if absent.
+// The avl* versions keep AVL trees balanced. Not for arena trees
+err_t delbtree(btreeptr_t *const root, const void *data, const size_t size);
+err_t fdelbtree(btreeptr_t *const root, const void *data, const size_t size,
+                long (*cmp)(const void *mem1, const void *mem2, size_t size));
+err_t avldelbtree(btreeptr_t *const root, const void *data,
+                  const size_t size);
+err_t favldelbtree(btreeptr_t *const root, const void *data,
+                   const size_t size,
+                   long (*cmp)(const void *mem1, const void *mem2,
+                               size_t size));
+
+// Arena mode: nodes and fixed-size data come from shared slabs
+err_t initbtarena(btarenaptr_t *const arena, const size_t size,
+                  const size_t hint);
+err_t ainitbtree(btarenaptr_t arena, btreeptr_t *const root, const void *data);
+err_t afinsbtree(btarenaptr_t arena, btreeptr_t *const root, const void *data,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size));
+err_t ainsbtree(btarenaptr_t arena, btreeptr_t *const root, const void *data);
+
+// Releases every node of the arena at once. Do not call freebtree on them
+void freebtarena(btarenaptr_t *arena);
+
+// Bulk load: perfectly balanced tree from a sorted array, in O(n), with the
+// nodes laid out contiguously in a new arena. sort != 0 sorts init_data first
+err_t initarrbtree(btarenaptr_t *const arena, btreeptr_t *const root,
+                   void *init_data, const size_t nmemb, const size_t size,
+                   int (*cmp)(const void *, const void *), const int sort);
 /**/
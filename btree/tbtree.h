@@ -0,0 +1,103 @@
+/*
+ * Versiones del árbol especializadas por tipo, armadas en tiempo de
+ * compilación: la comparación se escribe en línea (nada de punteros a
+ * función ni memcmp de tamaño variable) y las copias son de tamaño fijo,
+ * así el compilador puede optimizar el recorrido entero.
+ *
+ *   BTREE_DEFINE_TYPE(S, T, CMP)
+ *
+ * genera insbtree_S, avlinsbtree_S, findbtree_S y frehashbtree_S para datos
+ * de tipo T. CMP(a, b) recibe dos T y retorna negativo, 0 o positivo; puede
+ * ser una macro o una función inline. Ya vienen u64 (uint64_t) e i64
+ * (int64_t) con orden numérico.
+ *
+ * Los nodos son btree_t comunes, pero el orden es el de CMP: un árbol armado
+ * con insbtree_S se busca con findbtree_S (o ffindbtree con una función
+ * equivalente), no con findbtree.
+ */
+
+#ifndef BTREE_H
+#include "btree.h"
+#endif
+
+#include <stdint.h>
+
+#define TBTREE_H
+
+// -1, 0 o 1 sin saltos, para tipos numéricos
+#define BTREE_NUMCMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+#define BTREE_DEFINE_TYPE(S, T, CMP)                                           \
+  static inline err_t insbtree_##S(btreeptr_t *const root, const T data) {     \
+    if (nullptr == root)                                                       \
+      return EXIT_FAILURE_IMPROPER_USE;                                        \
+                                                                               \
+    btreeptr_t *link = root;                                                   \
+    int _compare_;                                                             \
+                                                                               \
+    while (*link) {                                                            \
+      if (nullptr == (*link)->data)                                            \
+        return EXIT_FAILURE_IMPROPER_USE;                                      \
+      _compare_ = CMP(data, *(const T *)(*link)->data);                        \
+      if (0 == _compare_)                                                      \
+        return EXIT_SUCCESS_REPEATED;                                          \
+      link = _compare_ > 0 ? &((*link)->right) : &((*link)->left);             \
+    }                                                                          \
+                                                                               \
+    return initbtree(link, &data, sizeof(T));                                  \
+  }                                                                            \
+                                                                               \
+  static inline err_t avlinsbtree_##S(btreeptr_t *const root, const T data) {  \
+    if (nullptr == root)                                                       \
+      return EXIT_FAILURE_IMPROPER_USE;                                        \
+                                                                               \
+    btreeptr_t *path[AVL_MAX_HEIGHT];                                          \
+    long depth = 0;                                                            \
+    btreeptr_t *link = root;                                                   \
+    int _compare_;                                                             \
+                                                                               \
+    while (*link) {                                                            \
+      if (nullptr == (*link)->data || AVL_MAX_HEIGHT == depth)                 \
+        return EXIT_FAILURE_IMPROPER_USE;                                      \
+      _compare_ = CMP(data, *(const T *)(*link)->data);                        \
+      if (0 == _compare_)                                                      \
+        return EXIT_SUCCESS_REPEATED;                                          \
+      path[depth++] = link;                                                    \
+      link = _compare_ > 0 ? &((*link)->right) : &((*link)->left);             \
+    }                                                                          \
+                                                                               \
+    if (EXIT_SUCCESS != __initavlbtree(link, &data, sizeof(T)))                \
+      return EXIT_FAILURE;                                                     \
+                                                                               \
+    __avlretrace(path, depth);                                                 \
+    return EXIT_SUCCESS;                                                       \
+  }                                                                            \
+                                                                               \
+  static inline err_t findbtree_##S(btreeptr_t root, const T data,             \
+                                    btreeptr_t *ret) {                         \
+    int _compare_;                                                             \
+                                                                               \
+    while (root) {                                                             \
+      if (nullptr == root->data)                                               \
+        return EXIT_FAILURE_IMPROPER_USE;                                      \
+      _compare_ = CMP(data, *(const T *)root->data);                           \
+      if (0 == _compare_) {                                                    \
+        *ret = root;                                                           \
+        return EXIT_SUCCESS;                                                   \
+      }                                                                        \
+      root = _compare_ > 0 ? root->right : root->left;                         \
+    }                                                                          \
+                                                                               \
+    return EXIT_FAILURE_NOT_FOUND;                                             \
+  }                                                                            \
+                                                                               \
+  static int __frehashcmp_##S(const void *a, const void *b) {                  \
+    return CMP(*(const T *)a, *(const T *)b);                                  \
+  }                                                                            \
+                                                                               \
+  static inline err_t frehashbtree_##S(btreeptr_t *root) {                     \
+    return frehashbtree(root, __frehashcmp_##S);                               \
+  }
+
+BTREE_DEFINE_TYPE(u64, uint64_t, BTREE_NUMCMP)
+BTREE_DEFINE_TYPE(i64, int64_t, BTREE_NUMCMP)
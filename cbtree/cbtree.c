@@ -0,0 +1,385 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Árbol binario concurrente:
+ * Muchos hilos pueden buscar, insertar y borrar a la vez sin un mutex global.
+ *
+ * ---Búsquedas: no toman ningún lock. Solo suman 1 a un contador de lectores
+ * (uno de CBTREE_SLOTS, repartidos por hilo y cada uno en su línea de caché)
+ * y lo restan al terminar. Sirve para saber cuándo nadie puede estar leyendo
+ * nodos viejos (estilo RCU).
+ * ---Inserciones: tampoco toman locks. Bajan igual que una búsqueda y cuelgan
+ * el nodo nuevo con un compare-and-swap sobre el enlace vacío; si otro hilo
+ * ganó ese lugar, siguen bajando desde ahí.
+ * ---Borrado: lógico, se marca el nodo como borrado (y se revive si se vuelve
+ * a insertar). La memoria se recupera en cfrehashbtree.
+ * ---cfrehashbtree: copia los nodos vivos a un árbol nuevo perfectamente
+ * balanceado y lo publica. Solo esto frena a los que escriben (no a los que
+ * leen); los nodos viejos se liberan cuando ya no queda ningún lector que
+ * haya empezado antes.
+ *
+ * Los nodos nunca se mueven ni se liberan mientras alguien puede verlos, por
+ * eso las búsquedas no necesitan validar nada. Como no hay rotaciones, el
+ * árbol se desbalancea igual que btree_t: llamar a cfrehashbtree de vez en
+ * cuando. Las claves son de tamaño fijo y se guardan dentro del nodo.
+ */
+
+#ifndef CBTREE_SLOTS
+#define CBTREE_SLOTS 64
+#endif
+
+typedef struct cbnode cbnode_t;
+typedef struct cbtree cbtree_t;
+typedef struct cbtree *cbtreeptr_t;
+
+struct cbnode {
+  cbnode_t *left, *right; // Siempre con __atomic
+  unsigned char deleted;
+  _Alignas(max_align_t) char data[];
+};
+
+typedef struct {
+  _Alignas(64) size_t readers[2]; // Por paridad de epoch
+  size_t writers;
+} __cbslot_t;
+
+struct cbtree {
+  cbnode_t *root;
+  size_t size;      // Tamaño de cada clave
+  size_t nodebytes; // sizeof(cbnode_t) + size, alineado
+  long (*cmp)(const void *mem1, const void *mem2, size_t size);
+  size_t epoch;
+  int rebuilding;
+  pthread_mutex_t rebuild;
+  char *block; // Nodos contiguos del último cfrehashbtree
+  size_t blockbytes;
+  __cbslot_t slots[CBTREE_SLOTS];
+};
+
+// Cada hilo recibe un número la primera vez, define su slot en cada árbol
+static size_t __cbtree_next = 0;
+static _Thread_local size_t __cbtree_id = (size_t)-1;
+
+static inline __cbslot_t *__cbslot(cbtreeptr_t tree) {
+  if ((size_t)-1 == __cbtree_id)
+    __cbtree_id = __atomic_fetch_add(&__cbtree_next, 1, __ATOMIC_RELAXED);
+  return tree->slots + __cbtree_id % CBTREE_SLOTS;
+}
+
+/*
+ * Entre leer epoch y anotarse pueden pasar cfrehashbtree enteros: si el
+ * lector se anota en una paridad que ya se esperó, el siguiente cambio
+ * espera la otra y libera el árbol que está leyendo. Por eso, ya anotado,
+ * vuelve a mirar epoch y si cambió se borra y prueba de nuevo. Si no cambió,
+ * todo cfrehashbtree que publique después de esto lo espera a él.
+ */
+static inline size_t __cbreadlock(cbtreeptr_t tree, __cbslot_t *slot) {
+  size_t epoch = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST), now;
+
+  while (1) {
+    __atomic_fetch_add(slot->readers + (epoch & 1), 1, __ATOMIC_SEQ_CST);
+    now = __atomic_load_n(&tree->epoch, __ATOMIC_SEQ_CST);
+    if (now == epoch)
+      return epoch & 1;
+    __atomic_fetch_sub(slot->readers + (epoch & 1), 1, __ATOMIC_SEQ_CST);
+    epoch = now;
+  }
+}
+
+static inline void __cbreadunlock(__cbslot_t *slot, size_t e) {
+  __atomic_fetch_sub(slot->readers + e, 1, __ATOMIC_RELEASE);
+}
+
+// Si hay un cfrehashbtree en curso, espera a que termine
+static inline void __cbwritelock(cbtreeptr_t tree, __cbslot_t *slot) {
+  while (1) {
+    __atomic_fetch_add(&slot->writers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&tree->rebuilding, __ATOMIC_SEQ_CST))
+      return;
+    __atomic_fetch_sub(&slot->writers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&tree->rebuild);
+    pthread_mutex_unlock(&tree->rebuild);
+  }
+}
+
+static inline void __cbwriteunlock(__cbslot_t *slot) {
+  __atomic_fetch_sub(&slot->writers, 1, __ATOMIC_RELEASE);
+}
+
+static inline long __cbcmp(cbtreeptr_t tree, const void *a, const void *b) {
+  if (tree->cmp)
+    return tree->cmp(a, b, tree->size);
+  return __builtin_memcmp(a, b, tree->size);
+}
+
+// cmp puede ser nullptr, en ese caso se compara con memcmp
+err_t initcbtree(cbtreeptr_t *const tree, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2,
+                             size_t size)) {
+  if (nullptr == tree || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *tree = (cbtreeptr_t)aligned_alloc(_Alignof(cbtree_t),
+                                     (sizeof(cbtree_t) + 63) / 64 * 64);
+  if (nullptr == *tree)
+    return EXIT_FAILURE;
+
+  memset(*tree, 0, sizeof(cbtree_t));
+  const size_t align = _Alignof(max_align_t);
+  (*tree)->size = size;
+  (*tree)->nodebytes = (sizeof(cbnode_t) + size + align - 1) / align * align;
+  (*tree)->cmp = cmp;
+
+  if (pthread_mutex_init(&((*tree)->rebuild), nullptr)) {
+    free(*tree);
+    *tree = nullptr;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Como findbtree, sin locks. Si out no es nullptr copia ahí la clave
+// guardada (útil si cmp compara solo una parte)
+err_t cfindbtree(cbtreeptr_t tree, const void *data, void *out) {
+  if (nullptr == tree || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __cbslot_t *slot = __cbslot(tree);
+  const size_t e = __cbreadlock(tree, slot);
+  err_t ret = EXIT_FAILURE_NOT_FOUND;
+  long _compare_;
+
+  cbnode_t *node = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+  while (node) {
+    _compare_ = __cbcmp(tree, data, node->data);
+    if (0 == _compare_) {
+      if (!__atomic_load_n(&node->deleted, __ATOMIC_ACQUIRE)) {
+        if (out)
+          memcpy(out, node->data, tree->size);
+        ret = EXIT_SUCCESS;
+      }
+      break;
+    }
+    node = __atomic_load_n(_compare_ > 0 ? &node->right : &node->left,
+                           __ATOMIC_ACQUIRE);
+  }
+
+  __cbreadunlock(slot, e);
+  return ret;
+}
+
+// Como insbtree: EXIT_SUCCESS_REPEATED si ya estaba (y no borrado)
+err_t cinsbtree(cbtreeptr_t tree, const void *data) {
+  if (nullptr == tree || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  // El nodo se prepara antes, así el compare-and-swap lo deja ya listo
+  cbnode_t *fresh = (cbnode_t *)malloc(tree->nodebytes), *node, *expected;
+  if (nullptr == fresh)
+    return EXIT_FAILURE;
+  fresh->left = nullptr;
+  fresh->right = nullptr;
+  fresh->deleted = 0;
+  memcpy(fresh->data, data, tree->size);
+
+  __cbslot_t *slot = __cbslot(tree);
+  __cbwritelock(tree, slot);
+
+  cbnode_t **link = &tree->root;
+  err_t ret = EXIT_SUCCESS;
+  long _compare_;
+
+  while (1) {
+    node = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+    if (nullptr == node) {
+      expected = nullptr;
+      if (__atomic_compare_exchange_n(link, &expected, fresh, 0,
+                                      __ATOMIC_RELEASE, __ATOMIC_ACQUIRE))
+        break;
+      node = expected; // Otro hilo colgó algo ahí primero
+    }
+
+    _compare_ = __cbcmp(tree, data, node->data);
+    if (0 == _compare_) {
+      // Revive el nodo si estaba borrado
+      ret = __atomic_exchange_n(&node->deleted, 0, __ATOMIC_ACQ_REL)
+                ? EXIT_SUCCESS
+                : EXIT_SUCCESS_REPEATED;
+      free(fresh);
+      break;
+    }
+    link = _compare_ > 0 ? &node->right : &node->left;
+  }
+
+  __cbwriteunlock(slot);
+  return ret;
+}
+
+// Borrado lógico. EXIT_FAILURE_NOT_FOUND si no estaba
+err_t cdelbtree(cbtreeptr_t tree, const void *data) {
+  if (nullptr == tree || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  __cbslot_t *slot = __cbslot(tree);
+  __cbwritelock(tree, slot);
+
+  err_t ret = EXIT_FAILURE_NOT_FOUND;
+  long _compare_;
+
+  cbnode_t *node = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+  while (node) {
+    _compare_ = __cbcmp(tree, data, node->data);
+    if (0 == _compare_) {
+      if (!__atomic_exchange_n(&node->deleted, 1, __ATOMIC_ACQ_REL))
+        ret = EXIT_SUCCESS;
+      break;
+    }
+    node = __atomic_load_n(_compare_ > 0 ? &node->right : &node->left,
+                           __ATOMIC_ACQUIRE);
+  }
+
+  __cbwriteunlock(slot);
+  return ret;
+}
+
+// Igual que __buildbtree en btree/
+static cbnode_t *__buildcbtree(char *base, const size_t stride, size_t len) {
+  if (0 == len)
+    return nullptr;
+
+  cbnode_t *node = (cbnode_t *)(base + len / 2 * stride);
+  node->left = __buildcbtree(base, stride, len / 2);
+  node->right =
+      __buildcbtree(base + (len / 2 + 1) * stride, stride, len - len / 2 - 1);
+  return node;
+}
+
+// Como __freebtree en btree/: rotaciones, memoria constante. Los nodos que
+// están dentro de block se liberan juntos después
+static void __freecbnodes(cbnode_t *node, const char *block,
+                          const size_t blockbytes) {
+  cbnode_t *aux;
+
+  while (node) {
+    if (node->left) {
+      aux = node->left;
+      node->left = aux->right;
+      aux->right = node;
+      node = aux;
+    } else {
+      aux = node->right;
+      if ((const char *)node < block || (const char *)node >= block + blockbytes)
+        free(node);
+      node = aux;
+    }
+  }
+}
+
+/*
+ * Reconstruye el árbol perfectamente balanceado, sin los borrados, con
+ * todos los nodos contiguos. Las búsquedas siguen mientras tanto (sobre el
+ * árbol viejo, que está completo porque nadie escribe), los que escriben
+ * esperan a que se publique el nuevo.
+ */
+err_t cfrehashbtree(cbtreeptr_t tree) {
+  if (nullptr == tree)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  pthread_mutex_lock(&tree->rebuild);
+  __atomic_store_n(&tree->rebuilding, 1, __ATOMIC_SEQ_CST);
+  for (size_t i = 0; i < CBTREE_SLOTS; ++i)
+    while (__atomic_load_n(&tree->slots[i].writers, __ATOMIC_SEQ_CST))
+      sched_yield();
+
+  // Recorrido en orden con pila propia: el árbol viejo puede ser muy alto
+  // y no se lo puede tocar (hay lectores)
+  cbnode_t **stack = nullptr, *node = tree->root, *old = tree->root;
+  size_t top = 0, cap = 0, len = 0;
+  char *block = nullptr, *oldblock = tree->block;
+  const size_t oldbytes = tree->blockbytes;
+  err_t ret = EXIT_FAILURE;
+
+  // Primera pasada cuenta, segunda copia
+  for (int pass = 0; pass < 2; ++pass) {
+    if (1 == pass) {
+      block = (char *)malloc(len * tree->nodebytes + 1);
+      if (nullptr == block)
+        goto end;
+      len = 0;
+      node = old;
+    }
+
+    while (node || top) {
+      while (node) {
+        if (top == cap) {
+          cap = cap ? 2 * cap : 64;
+          cbnode_t **aux = (cbnode_t **)realloc(stack, cap * sizeof(*stack));
+          if (nullptr == aux) {
+            free(block);
+            goto end;
+          }
+          stack = aux;
+        }
+        stack[top++] = node;
+        node = node->left;
+      }
+
+      node = stack[--top];
+      if (!node->deleted) {
+        if (pass)
+          memcpy(((cbnode_t *)(block + len * tree->nodebytes))->data,
+                 node->data, tree->size);
+        ++len;
+      }
+      node = node->right;
+    }
+  }
+
+  for (size_t i = 0; i < len; ++i)
+    ((cbnode_t *)(block + i * tree->nodebytes))->deleted = 0;
+
+  __atomic_store_n(&tree->root, __buildcbtree(block, tree->nodebytes, len),
+                   __ATOMIC_SEQ_CST);
+  tree->block = block;
+  tree->blockbytes = len * tree->nodebytes;
+  __atomic_store_n(&tree->rebuilding, 0, __ATOMIC_SEQ_CST);
+
+  // Período de gracia: los lectores que pueden tener el árbol viejo son los
+  // que entraron con la paridad anterior
+  const size_t e = __atomic_fetch_add(&tree->epoch, 1, __ATOMIC_SEQ_CST) & 1;
+  for (size_t i = 0; i < CBTREE_SLOTS; ++i)
+    while (__atomic_load_n(tree->slots[i].readers + e, __ATOMIC_SEQ_CST))
+      sched_yield();
+
+  __freecbnodes(old, oldblock, oldbytes);
+  free(oldblock);
+  ret = EXIT_SUCCESS;
+
+end:
+  __atomic_store_n(&tree->rebuilding, 0, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&tree->rebuild);
+  free(stack);
+  return ret;
+}
+
+// Nadie más puede estar usando el árbol. Si tree es nullptr no hace nada
+void freecbtree(cbtreeptr_t *tree) {
+  if (nullptr == tree || nullptr == *tree)
+    return;
+
+  __freecbnodes((*tree)->root, (*tree)->block, (*tree)->blockbytes);
+  free((*tree)->block);
+  pthread_mutex_destroy(&((*tree)->rebuild));
+  free(*tree);
+  *tree = nullptr;
+}
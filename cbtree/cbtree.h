@@ -0,0 +1,27 @@
+/*
+ * Written by Thostin
+ * Github: https://github.com/Thostin
+ */
+
+#include "cbtree.c"
+
+#define CBTREE_H
+
+// Concurrent binary tree of fixed-size keys. Link with -pthread.
+// cmp may be nullptr to use __builtin_memcmp
+err_t initcbtree(cbtreeptr_t *const tree, const size_t size,
+                 long (*cmp)(const void *mem1, const void *mem2, size_t size));
+
+// Lock-free lookup. out (optional) receives a copy of the stored key
+err_t cfindbtree(cbtreeptr_t tree, const void *data, void *out);
+
+// Lock-free insert and logical delete
+err_t cinsbtree(cbtreeptr_t tree, const void *data);
+err_t cdelbtree(cbtreeptr_t tree, const void *data);
+
+// Balanced copy without deleted keys, published RCU-style. Readers keep
+// going; writers wait for it
+err_t cfrehashbtree(cbtreeptr_t tree);
+
+// No other thread may be using the tree
+void freecbtree(cbtreeptr_t *tree);
@@ -1,9 +1,581 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Registro de estados (solo se agrega al final):
+ *
+ * Archivo: "DCLSTAT1" y después los registros, uno detrás de otro, cada uno
+ * alineado a 8 bytes:
+ *   cabecera  magic, len, time (ns desde epoch), crc, 0
+ *   texto     len bytes, relleno con ceros hasta múltiplo de 8
+ *   pie       len, magic de fin
+ * El crc (crc32c) cubre len, time y el texto, así un registro a medio
+ * escribir (corte de luz) no pasa por bueno. Al abrir se recorre desde el
+ * principio y se corta el archivo en el primer registro roto (lo que sigue
+ * era de la misma tanda sin fsync).
+ *
+ * closestatus, si pudo hacer fsync de todo, agrega al final una marca de
+ * cierre limpio (un pie con len 0 y magic STATUS_CLEAN). Si al abrir el
+ * archivo termina en la marca no hace falta recorrerlo: se revisa solo el
+ * último registro (por el pie) y se saca la marca. Sin la marca (corte de
+ * luz, proceso muerto) las páginas que no llegaron a disco pueden dejar un
+ * registro roto en el medio con el último bien, así que se recorre todo.
+ *
+ * Un write que falla a la mitad no deja registros rotos en el medio: se
+ * corta el archivo donde terminaba el último registro entero, y si ni eso
+ * se puede no se escribe más (y no se pone la marca). Por lo mismo, un
+ * solo proceso por vez escribe en cada registro: openstatus toma un flock
+ * exclusivo antes de revisar el archivo y lo tiene hasta closestatus; otro
+ * proceso que abra el mismo registro espera ahí.
+ *
+ * Escritura: los registros se arman en un buffer propio y salen en un solo
+ * write cuando se llena (writev si un registro no entra). fsync según
+ * policy: STATUS_SYNC_CALL en cada appendstatus, STATUS_SYNC_COUNT cada
+ * every registros, STATUS_SYNC_NONE solo al cerrar. Con STATUS_SYNC_TIME un
+ * hilo aparte vacía el buffer y hace fsync cada every milisegundos si hay
+ * algo pendiente, así un corte pierde a lo sumo esa ventana aunque no se
+ * agregue nada más. Las funciones de un statuslog_t se pueden llamar desde
+ * varios hilos (hay un mutex), link con -pthread.
+ */
+
+#define STATUS_FILE_MAGIC "DCLSTAT1"
+#define STATUS_MAGIC 0xdc15a7a5U
+#define STATUS_END 0x5a7adc15U
+#define STATUS_CLEAN 0xc1ea2dc1U
+
+#define STATUS_SYNC_NONE 0
+#define STATUS_SYNC_CALL 1
+#define STATUS_SYNC_COUNT 2
+#define STATUS_SYNC_TIME 3
+
+#ifndef STATUS_BUFFER
+#define STATUS_BUFFER (1 << 20)
+#endif
+
+typedef struct {
+  uint32_t magic;
+  uint32_t len;
+  uint64_t time;
+  uint32_t crc;
+  uint32_t zero;
+} statushead_t;
+
+typedef struct {
+  uint32_t len;
+  uint32_t magic;
+} statusfoot_t;
+
+typedef struct statuslog statuslog_t;
+
+struct statuslog {
+  int fd;
+  char *buf;
+  size_t used;
+  size_t size;      // Fin del último registro entero en el archivo
+  int broken;       // Un write falló y no se pudo cortar lo escrito
+  int policy;
+  uint64_t every;   // Registros o milisegundos, según policy
+  size_t pending;   // Registros escritos desde el último fsync
+  uint64_t synced;  // Cuándo fue el último fsync (ns, monotónico)
+  uint64_t records; // Agregados desde que se abrió
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Para despertar al hilo de STATUS_SYNC_TIME
+  pthread_t timer;
+  int timing;          // El hilo está corriendo
+};
+
+// Bytes que ocupa un registro con len bytes de texto
+#define __statussize(len)                                                      \
+  (sizeof(statushead_t) + (((size_t)(len) + 7) & ~(size_t)7) +                 \
+   sizeof(statusfoot_t))
+
+#ifndef __SSE4_2__
+static uint32_t __crctable[256];
+
+static void __crcinit(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+      c = c & 1 ? (c >> 1) ^ 0x82f63b78U : c >> 1;
+    __crctable[i] = c;
+  }
+}
+#endif
+
+// crc32c, con la instrucción de SSE4.2 si se compila con -msse4.2
+static uint32_t __crc32c(uint32_t crc, const void *data, size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+
+  crc = ~crc;
+#ifdef __SSE4_2__
+  uint64_t word;
+  for (; len >= 8; len -= 8, p += 8) {
+    memcpy(&word, p, 8);
+    crc = (uint32_t)_mm_crc32_u64(crc, word);
+  }
+  for (; len; --len)
+    crc = _mm_crc32_u8(crc, *p++);
+#else
+  if (0 == __crctable[1])
+    __crcinit();
+  for (; len; --len)
+    crc = (crc >> 8) ^ __crctable[(crc ^ *p++) & 0xff];
+#endif
+  return ~crc;
+}
+
+static inline uint32_t __statuscrc(uint32_t len, uint64_t time,
+                                   const void *text) {
+  uint32_t crc = __crc32c(0, &len, sizeof(len));
+  crc = __crc32c(crc, &time, sizeof(time));
+  return __crc32c(crc, text, len);
+}
+
+static inline uint64_t __statusnow(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Tamaño del registro que empieza en off si está entero y bien, 0 si no
+static size_t __statusvalid(const char *map, size_t off, size_t size) {
+  statushead_t head;
+  statusfoot_t foot;
+
+  if (off + sizeof(statushead_t) > size)
+    return 0;
+  memcpy(&head, map + off, sizeof(head));
+  if (STATUS_MAGIC != head.magic || __statussize(head.len) > size - off)
+    return 0;
+
+  size_t rec = __statussize(head.len);
+  memcpy(&foot, map + off + rec - sizeof(foot), sizeof(foot));
+  if (STATUS_END != foot.magic || foot.len != head.len ||
+      head.crc != __statuscrc(head.len, head.time, map + off + sizeof(head)))
+    return 0;
+  return rec;
+}
+
+/*
+ * Deja el archivo terminado en un registro entero. Si termina en la marca
+ * de cierre limpio mira solo el último registro (por el pie) y saca la
+ * marca; si no, o si el último no está bien, recorre todo y corta en el
+ * primer registro roto. EXIT_FAILURE_IMPROPER_USE si no es un registro de
+ * estados.
+ */
+static err_t __statusrecover(int fd) {
+  struct stat st;
+  const size_t start = sizeof(STATUS_FILE_MAGIC) - 1;
+  statusfoot_t foot;
+  size_t size, off, rec;
+  err_t ret = EXIT_SUCCESS;
+
+  if (fstat(fd, &st))
+    return EXIT_FAILURE;
+  size = st.st_size;
+
+  // Vacío o cortado antes de terminar la cabecera del archivo
+  if (size < start) {
+    char magic[8];
+    if (size && (pread(fd, magic, size, 0) != (ssize_t)size ||
+                 memcmp(magic, STATUS_FILE_MAGIC, size)))
+      return EXIT_FAILURE_IMPROPER_USE;
+    if (ftruncate(fd, 0) ||
+        pwrite(fd, STATUS_FILE_MAGIC, start, 0) != (ssize_t)start)
+      return EXIT_FAILURE;
+    return fsync(fd) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  char *map = (char *)mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == map)
+    return EXIT_FAILURE;
+  if (memcmp(map, STATUS_FILE_MAGIC, start)) {
+    munmap(map, size);
+    return EXIT_FAILURE_IMPROPER_USE;
+  }
+  if (size == start)
+    goto end;
+
+  off = size - sizeof(foot);
+  if (0 == size % 8 && off >= start) {
+    memcpy(&foot, map + off, sizeof(foot));
+    if (STATUS_CLEAN == foot.magic && 0 == foot.len) {
+      if (off == start)
+        goto cut;
+      memcpy(&foot, map + off - sizeof(foot), sizeof(foot));
+      if (STATUS_END == foot.magic && __statussize(foot.len) <= off - start &&
+          __statusvalid(map, off - __statussize(foot.len), off))
+        goto cut;
+    }
+  }
+
+  for (off = start; (rec = __statusvalid(map, off, size)); off += rec)
+    ;
+  if (off == size)
+    goto end;
+cut:
+  if (ftruncate(fd, off) || fsync(fd))
+    ret = EXIT_FAILURE;
+
+end:
+  munmap(map, size);
+  return ret;
+}
+
+static void *__statustimer(void *arg);
+
+// Abre (o crea) el registro en path. every es la cantidad de registros
+// (STATUS_SYNC_COUNT) o los milisegundos (STATUS_SYNC_TIME) entre fsync
+err_t openstatus(statuslog_t *log, const char *path, const int policy,
+                 const uint64_t every) {
+  if (nullptr == log || nullptr == path || policy < STATUS_SYNC_NONE ||
+      policy > STATUS_SYNC_TIME)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  log->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (log->fd < 0)
+    return EXIT_FAILURE;
+
+  // Con el lock, log->size es el tamaño del archivo mientras esté abierto
+  err_t ret = EXIT_FAILURE;
+  int locked;
+  while ((locked = flock(log->fd, LOCK_EX)) && EINTR == errno)
+    ;
+  if (locked)
+    goto err;
+
+  ret = __statusrecover(log->fd);
+  if (EXIT_SUCCESS != ret)
+    goto err;
+
+  log->buf = (char *)malloc(STATUS_BUFFER);
+  if (nullptr == log->buf) {
+    ret = EXIT_FAILURE;
+    goto err;
+  }
+
+  struct stat st;
+  if (fstat(log->fd, &st)) {
+    free(log->buf);
+    ret = EXIT_FAILURE;
+    goto err;
+  }
+
+  log->used = 0;
+  log->size = st.st_size;
+  log->broken = 0;
+  log->policy = policy;
+  log->every = every ? every : 1;
+  log->pending = 0;
+  log->synced = __statusnow(CLOCK_MONOTONIC);
+  log->records = 0;
+  log->timing = 0;
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&log->lock, nullptr);
+  pthread_cond_init(&log->wake, &attr);
+  pthread_condattr_destroy(&attr);
+
+  if (STATUS_SYNC_TIME == policy) {
+    log->timing = 1;
+    if (pthread_create(&log->timer, nullptr, __statustimer, log)) {
+      pthread_cond_destroy(&log->wake);
+      pthread_mutex_destroy(&log->lock);
+      free(log->buf);
+      ret = EXIT_FAILURE;
+      goto err;
+    }
+  }
+  return EXIT_SUCCESS;
+
+err:
+  close(log->fd);
+  log->fd = -1;
+  return ret;
+}
+
+// Escribe todo iov, reintentando si write escribe menos
+static err_t __statuswritev(int fd, struct iovec *iov, int n) {
+  while (n) {
+    ssize_t done = writev(fd, iov, n);
+    if (done < 0)
+      return EXIT_FAILURE;
+    for (; n && (size_t)done >= iov->iov_len; --n, ++iov)
+      done -= iov->iov_len;
+    if (n) {
+      iov->iov_base = (char *)iov->iov_base + done;
+      iov->iov_len -= done;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Escribe iov (registros enteros) al final del archivo. Si falla, corta lo
+ * que haya llegado a escribirse para que un reintento no deje un registro
+ * roto en el medio; si tampoco se puede cortar, el registro queda roto.
+ */
+static err_t __statusput(statuslog_t *log, struct iovec *iov, int n) {
+  size_t bytes = 0;
+  for (int i = 0; i < n; ++i)
+    bytes += iov[i].iov_len;
+
+  if (log->broken)
+    return EXIT_FAILURE;
+  if (__statuswritev(log->fd, iov, n)) {
+    if (ftruncate(log->fd, log->size))
+      log->broken = 1;
+    return EXIT_FAILURE;
+  }
+  log->size += bytes;
+  return EXIT_SUCCESS;
+}
+
+// Las que empiezan con __ suponen log->lock tomado
+static err_t __flushstatus(statuslog_t *log) {
+  if (0 == log->used)
+    return EXIT_SUCCESS;
+
+  struct iovec iov = {log->buf, log->used};
+  if (__statusput(log, &iov, 1))
+    return EXIT_FAILURE;
+  log->used = 0;
+  return EXIT_SUCCESS;
+}
+
+static err_t __syncstatus(statuslog_t *log) {
+  if (EXIT_SUCCESS != __flushstatus(log) || fdatasync(log->fd))
+    return EXIT_FAILURE;
+  log->pending = 0;
+  log->synced = __statusnow(CLOCK_MONOTONIC);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Hilo de STATUS_SYNC_TIME: cada every milisegundos, si hay registros sin
+ * fsync, vacía el buffer y hace fdatasync. El fdatasync va sin el mutex
+ * para no frenar a los que agregan; los errores los ve el próximo
+ * syncstatus o closestatus.
+ */
+static void *__statustimer(void *arg) {
+  statuslog_t *log = (statuslog_t *)arg;
+  struct timespec ts;
+  size_t pending;
+
+  pthread_mutex_lock(&log->lock);
+  while (log->timing) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += log->every / 1000;
+    ts.tv_nsec += (log->every % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+      ++ts.tv_sec;
+      ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&log->wake, &log->lock, &ts);
+    if (!log->timing || 0 == log->pending ||
+        EXIT_SUCCESS != __flushstatus(log))
+      continue;
+
+    pending = log->pending;
+    pthread_mutex_unlock(&log->lock);
+    const int err = fdatasync(log->fd);
+    pthread_mutex_lock(&log->lock);
+    if (!err) {
+      // Un syncstatus de otro hilo pudo haberlo puesto en 0 mientras tanto
+      log->pending = log->pending > pending ? log->pending - pending : 0;
+      log->synced = __statusnow(CLOCK_MONOTONIC);
+    }
+  }
+  pthread_mutex_unlock(&log->lock);
+  return nullptr;
+}
+
+// Manda el buffer al archivo (sin fsync). Si falla el buffer queda igual
+// y se puede reintentar
+err_t flushstatus(statuslog_t *log) {
+  if (nullptr == log || log->fd < 0)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  pthread_mutex_lock(&log->lock);
+  err_t ret = __flushstatus(log);
+  pthread_mutex_unlock(&log->lock);
+  return ret;
+}
+
+// flushstatus + fdatasync: todo lo agregado hasta acá queda en disco
+err_t syncstatus(statuslog_t *log) {
+  if (nullptr == log || log->fd < 0)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  pthread_mutex_lock(&log->lock);
+  err_t ret = __syncstatus(log);
+  pthread_mutex_unlock(&log->lock);
+  return ret;
+}
+
+static err_t __appendstatus(statuslog_t *log, const void *text,
+                            const size_t len) {
+  const size_t rec = __statussize(len);
+  statushead_t head = {STATUS_MAGIC, (uint32_t)len,
+                       __statusnow(CLOCK_REALTIME), 0, 0};
+  statusfoot_t foot = {(uint32_t)len, STATUS_END};
+  char tail[8 + sizeof(statusfoot_t)] = {0};
+  head.crc = __statuscrc(head.len, head.time, text);
+
+  if (rec > STATUS_BUFFER - log->used) {
+    if (rec > STATUS_BUFFER) {
+      // No entra nunca: sale junto con lo que había, en un writev
+      const size_t pad = rec - sizeof(head) - len - sizeof(foot);
+      memcpy(tail + pad, &foot, sizeof(foot));
+      struct iovec iov[4] = {{log->buf, log->used},
+                             {&head, sizeof(head)},
+                             {(void *)text, len},
+                             {tail, pad + sizeof(foot)}};
+      if (__statusput(log, iov, 4))
+        return EXIT_FAILURE;
+      log->used = 0;
+      goto written;
+    }
+    if (__flushstatus(log))
+      return EXIT_FAILURE;
+  }
+
+  char *dst = log->buf + log->used;
+  memcpy(dst, &head, sizeof(head));
+  memcpy(dst + sizeof(head), text, len);
+  memset(dst + sizeof(head) + len, 0, rec - sizeof(head) - len);
+  memcpy(dst + rec - sizeof(foot), &foot, sizeof(foot));
+  log->used += rec;
+
+written:
+  ++log->records;
+  ++log->pending;
+  switch (log->policy) {
+  case STATUS_SYNC_CALL:
+    return __syncstatus(log);
+  case STATUS_SYNC_COUNT:
+    if (log->pending >= log->every)
+      return __syncstatus(log);
+    break;
+  }
+  return EXIT_SUCCESS;
+}
+
+// Agrega un registro con los len bytes de text
+err_t appendstatus(statuslog_t *log, const void *text, const size_t len) {
+  if (nullptr == log || log->fd < 0 || (len && nullptr == text) ||
+      len > UINT32_MAX)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  pthread_mutex_lock(&log->lock);
+  err_t ret = __appendstatus(log, text, len);
+  pthread_mutex_unlock(&log->lock);
+  return ret;
+}
+
+// syncstatus y cierra. Si log ya estaba cerrado no hace nada
+err_t closestatus(statuslog_t *log) {
+  if (nullptr == log || log->fd < 0)
+    return EXIT_SUCCESS;
+
+  if (log->timing) {
+    pthread_mutex_lock(&log->lock);
+    log->timing = 0;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->timer, nullptr);
+  }
+
+  // La marca va después del fsync: si está, todo lo anterior está en disco
+  err_t ret = syncstatus(log);
+  statusfoot_t clean = {0, STATUS_CLEAN};
+  struct iovec iov = {&clean, sizeof(clean)};
+  if (EXIT_SUCCESS == ret && !log->broken)
+    __statuswritev(log->fd, &iov, 1);
+  if (close(log->fd))
+    ret = EXIT_FAILURE;
+  pthread_cond_destroy(&log->wake);
+  pthread_mutex_destroy(&log->lock);
+  free(log->buf);
+  log->buf = nullptr;
+  log->fd = -1;
+  return ret;
+}
+
+/*
+ * Registro por defecto del programa, se abre la primera vez:
+ *   DCL_LOG   archivo (dcl.log si no está)
+ *   DCL_SYNC  call, N (cada N registros) o Nms (cada N milisegundos);
+ *             por defecto 100ms
+ * Se cierra solo al terminar el programa (con exit o volviendo de main).
+ */
+static statuslog_t __status = {.fd = -1};
+
+static void __statusexit(void) { closestatus(&__status); }
+
+static statuslog_t *__statusdefault(void) {
+  if (__status.fd >= 0)
+    return &__status;
+
+  const char *path = getenv("DCL_LOG"), *sync = getenv("DCL_SYNC");
+  int policy = STATUS_SYNC_TIME;
+  uint64_t every = 100;
+  char *end;
+
+  if (nullptr == path)
+    path = "dcl.log";
+  if (sync && 0 == strcmp(sync, "call"))
+    policy = STATUS_SYNC_CALL;
+  else if (sync) {
+    every = strtoull(sync, &end, 10);
+    policy = 0 == strcmp(end, "ms") ? STATUS_SYNC_TIME : STATUS_SYNC_COUNT;
+  }
+
+  if (openstatus(&__status, path, policy, every)) {
+    fprintf(stderr, "dcl: no se pudo abrir %s\n", path);
+    return nullptr;
+  }
+  atexit(__statusexit);
+  return &__status;
+}
 
 void write_status(char *str) {
-  // TODO
+  statuslog_t *log = __statusdefault();
+  if (log && str && appendstatus(log, str, strlen(str)))
+    fprintf(stderr, "dcl: no se pudo escribir el estado\n");
 }
 
+// Un estado por línea desde la entrada estándar, hasta EOF
 void insert_status(void) {
-  // TODO
+  char *line = nullptr;
+  size_t cap = 0;
+  ssize_t len;
+
+  while ((len = getline(&line, &cap, stdin)) > 0) {
+    if ('\n' == line[len - 1])
+      line[--len] = '\0';
+    write_status(line);
+  }
+  free(line);
 }
@@ -0,0 +1,412 @@
+#ifndef BTREE_H
+#include "../btree/btree.h"
+#endif
+
+/*
+ * Lectura indexada del registro de estados:
+ * El registro se mapea con mmap y se arma un índice de dos órdenes sobre
+ * los registros: por tiempo y por clave (la primera palabra del estado,
+ * hasta el primer espacio, truncada a STATUS_KEY bytes). Cada orden se
+ * carga en un btree_t balanceado (initarrbtree) y las consultas son
+ * frangebtree: solo se tocan los registros que coinciden.
+ *
+ * El índice se guarda al lado, en <registro>.idx, con los dos arreglos
+ * ordenados y hasta qué byte del registro cubre. Al abrir de nuevo un
+ * registro que creció solo se leen los registros nuevos: se ordenan, se
+ * mezclan con los arreglos guardados (lineal) y se reescribe el .idx.
+ * Si el registro ya no coincide con el índice (otro archivo, o se lo
+ * cortó) o el .idx está dañado (crc de los arreglos) se indexa desde el
+ * principio. Igual, antes de leer un registro se revisa que esté entero.
+ */
+
+#ifndef STATUS_KEY
+#define STATUS_KEY 16
+#endif
+
+#define STATUS_INDEX_MAGIC "DCLIDX02"
+
+typedef struct {
+  char key[STATUS_KEY]; // Con ceros al final
+  uint64_t time;
+  uint64_t off; // Dónde empieza el registro
+} statusentry_t;
+
+typedef struct {
+  char magic[8];
+  uint64_t end;   // Bytes del registro cubiertos
+  uint64_t len;   // Entradas de cada arreglo
+  uint32_t crc;   // crc del último registro cubierto (0 si no hay)
+  uint32_t body;  // crc32c de los dos arreglos
+} __statusindexhead_t;
+
+typedef struct statusindex statusindex_t;
+
+struct statusindex {
+  int fd;
+  char *map;
+  size_t mapped; // Bytes mapeados
+  size_t size;   // Hasta el último registro entero
+  size_t len;
+  btarenaptr_t timearena, keyarena;
+  btreeptr_t timeroot, keyroot;
+};
+
+// Lo que recibe el que consulta: texto (sin '\0'), largo y tiempo
+typedef int (*statusfn_t)(const char *text, size_t len, uint64_t time,
+                          void *arg);
+
+static long __bytime(const void *a, const void *b, size_t size) {
+  const statusentry_t *x = (const statusentry_t *)a,
+                      *y = (const statusentry_t *)b;
+  (void)size;
+  if (x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return (x->off > y->off) - (x->off < y->off);
+}
+
+static long __bykey(const void *a, const void *b, size_t size) {
+  const statusentry_t *x = (const statusentry_t *)a,
+                      *y = (const statusentry_t *)b;
+  int c = memcmp(x->key, y->key, STATUS_KEY);
+  return c ? c : __bytime(a, b, size);
+}
+
+// Para qsort e initarrbtree
+static int __qbytime(const void *a, const void *b) {
+  return (int)__bytime(a, b, 0);
+}
+
+static int __qbykey(const void *a, const void *b) {
+  return (int)__bykey(a, b, 0);
+}
+
+// Copia la clave de text (primera palabra) a key
+static void __statuskey(char *key, const char *text, size_t len) {
+  size_t i;
+  memset(key, 0, STATUS_KEY);
+  for (i = 0; i < len && i < STATUS_KEY && ' ' != text[i] && '\t' != text[i];
+       ++i)
+    key[i] = text[i];
+}
+
+// Mezcla a (len) y b (n) ordenados en dst
+static void __statusmerge(statusentry_t *dst, const statusentry_t *a,
+                          size_t len, const statusentry_t *b, size_t n,
+                          long (*cmp)(const void *, const void *, size_t)) {
+  size_t i = 0, j = 0;
+  while (i < len && j < n)
+    *dst++ = cmp(b + j, a + i, 0) < 0 ? b[j++] : a[i++];
+  if (i < len)
+    memcpy(dst, a + i, (len - i) * sizeof(statusentry_t));
+  if (j < n)
+    memcpy(dst + len - i, b + j, (n - j) * sizeof(statusentry_t));
+}
+
+// crc del registro que termina en end, 0 si end es el principio
+static uint32_t __statuslastcrc(const char *map, size_t end) {
+  statusfoot_t foot;
+  statushead_t head;
+  const size_t start = sizeof(STATUS_FILE_MAGIC) - 1;
+
+  if (end <= start)
+    return 0;
+  memcpy(&foot, map + end - sizeof(foot), sizeof(foot));
+  if (STATUS_END != foot.magic || __statussize(foot.len) > end - start ||
+      0 == __statusvalid(map, end - __statussize(foot.len), end))
+    return 1; // No es un crc posible de "sin registros", no coincide
+  memcpy(&head, map + end - __statussize(foot.len), sizeof(head));
+  return head.crc;
+}
+
+// El primer registro entero desde off (alineado a 8), size si no hay
+static size_t __statusnext(const char *map, size_t off, size_t size) {
+  for (; off + __statussize(0) <= size; off += 8)
+    if (__statusvalid(map, off, size))
+      return off;
+  return size;
+}
+
+/*
+ * Carga el .idx si coincide con el registro: deja los dos arreglos en
+ * *bytime y *bykey y hasta dónde cubre en *end.
+ * Si no hay .idx o no sirve, arreglos vacíos y end al principio.
+ */
+static err_t __statusloadindex(const char *path, const char *map, size_t size,
+                               statusentry_t **bytime, statusentry_t **bykey,
+                               size_t *len, size_t *end) {
+  __statusindexhead_t head;
+  const size_t start = sizeof(STATUS_FILE_MAGIC) - 1;
+  int fd = open(path, O_RDONLY);
+
+  *bytime = *bykey = nullptr;
+  *len = 0;
+  *end = start;
+  if (fd < 0)
+    return EXIT_SUCCESS;
+
+  struct stat st;
+  if (fstat(fd, &st) ||
+      pread(fd, &head, sizeof(head), 0) != sizeof(head) ||
+      memcmp(head.magic, STATUS_INDEX_MAGIC, sizeof(head.magic)) ||
+      head.end < start || head.end > size ||
+      head.len > (size - start) / __statussize(0) ||
+      (size_t)st.st_size !=
+          sizeof(head) + 2 * head.len * sizeof(statusentry_t) ||
+      head.crc != __statuslastcrc(map, head.end))
+    goto fresh;
+
+  const size_t bytes = head.len * sizeof(statusentry_t);
+  *bytime = (statusentry_t *)malloc(bytes + 1);
+  *bykey = (statusentry_t *)malloc(bytes + 1);
+  if (nullptr == *bytime || nullptr == *bykey ||
+      pread(fd, *bytime, bytes, sizeof(head)) != (ssize_t)bytes ||
+      pread(fd, *bykey, bytes, sizeof(head) + bytes) != (ssize_t)bytes)
+    goto bad;
+
+  // Un .idx mezclado o cortado puede tener buena cabecera: se revisa todo
+  // y que cada entrada caiga dentro de lo cubierto
+  if (head.body != __crc32c(__crc32c(0, *bytime, bytes), *bykey, bytes))
+    goto bad;
+  for (size_t i = 0; i < head.len; ++i)
+    if ((*bytime)[i].off < start || (*bykey)[i].off < start ||
+        (*bytime)[i].off % 8 || (*bykey)[i].off % 8 ||
+        (*bytime)[i].off + __statussize(0) > head.end ||
+        (*bykey)[i].off + __statussize(0) > head.end)
+      goto bad;
+
+  *len = head.len;
+  *end = head.end;
+  goto fresh;
+
+bad:
+  free(*bytime);
+  free(*bykey);
+  *bytime = *bykey = nullptr;
+
+fresh:
+  close(fd);
+  return EXIT_SUCCESS;
+}
+
+// Escribe el .idx entero en un temporal único (mkstemp, así dos lectores a
+// la vez no se pisan) y lo pone en su lugar con rename: gana el último
+static err_t __statussaveindex(const char *path, const statusentry_t *bytime,
+                               const statusentry_t *bykey, size_t len,
+                               size_t end, uint32_t crc) {
+  const size_t bytes = len * sizeof(statusentry_t);
+  __statusindexhead_t head = {
+      STATUS_INDEX_MAGIC, end, len, crc,
+      __crc32c(__crc32c(0, bytime, bytes), bykey, bytes)};
+  char tmp[4096];
+
+  if ((size_t)snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= sizeof(tmp))
+    return EXIT_FAILURE;
+  int fd = mkstemp(tmp);
+  if (fd < 0)
+    return EXIT_FAILURE;
+  fchmod(fd, 0644);
+
+  struct iovec iov[3] = {{&head, sizeof(head)},
+                         {(void *)bytime, bytes},
+                         {(void *)bykey, bytes}};
+  if (__statuswritev(fd, iov, 3) || fsync(fd)) {
+    close(fd);
+    unlink(tmp);
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  return rename(tmp, path) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Abre el registro en path para consultas, con el índice al día
+err_t openstatusindex(statusindex_t *idx, const char *path) {
+  if (nullptr == idx || nullptr == path)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  const size_t start = sizeof(STATUS_FILE_MAGIC) - 1;
+  statusentry_t *bytime = nullptr, *bykey = nullptr, *fresh = nullptr, *aux;
+  size_t len, end, off, last, rec, n = 0, cap = 0;
+  statushead_t head;
+  struct stat st;
+  char ipath[4096];
+  err_t ret = EXIT_FAILURE;
+
+  memset(idx, 0, sizeof(statusindex_t));
+  idx->fd = open(path, O_RDONLY);
+  if (idx->fd < 0)
+    return EXIT_FAILURE;
+  if (fstat(idx->fd, &st) || (size_t)st.st_size < start)
+    goto err0;
+
+  idx->mapped = idx->size = st.st_size;
+  idx->map = (char *)mmap(nullptr, idx->mapped, PROT_READ, MAP_SHARED, idx->fd,
+                          0);
+  if (MAP_FAILED == idx->map) {
+    idx->map = nullptr;
+    goto err0;
+  }
+  if (memcmp(idx->map, STATUS_FILE_MAGIC, start)) {
+    ret = EXIT_FAILURE_IMPROPER_USE;
+    goto err0;
+  }
+  madvise(idx->map, idx->mapped, MADV_RANDOM);
+
+  if ((size_t)snprintf(ipath, sizeof(ipath), "%s.idx", path) >= sizeof(ipath))
+    goto err0;
+  __statusloadindex(ipath, idx->map, idx->size, &bytime, &bykey, &len, &end);
+
+  // Solo la cola nueva. Un registro roto en el medio (corte de luz) se
+  // saltea hasta el siguiente entero; si no hay ninguno después es la cola
+  // que se está escribiendo y el índice cubre hasta antes de ella
+  for (off = last = end; off < idx->size; off += rec, last = off) {
+    if (0 == (rec = __statusvalid(idx->map, off, idx->size))) {
+      off = __statusnext(idx->map, off + 8, idx->size);
+      if (off == idx->size)
+        break;
+      rec = __statusvalid(idx->map, off, idx->size);
+    }
+    if (n == cap) {
+      cap = cap ? 2 * cap : 1024;
+      aux = (statusentry_t *)realloc(fresh, cap * sizeof(statusentry_t));
+      if (nullptr == aux)
+        goto err1;
+      fresh = aux;
+    }
+    memcpy(&head, idx->map + off, sizeof(head));
+    __statuskey(fresh[n].key, idx->map + off + sizeof(head), head.len);
+    fresh[n].time = head.time;
+    fresh[n].off = off;
+    ++n;
+  }
+  idx->size = last;
+
+  if (n) {
+    statusentry_t *t = (statusentry_t *)malloc((len + n) *
+                                               sizeof(statusentry_t));
+    statusentry_t *k = (statusentry_t *)malloc((len + n) *
+                                               sizeof(statusentry_t));
+    if (nullptr == t || nullptr == k) {
+      free(t);
+      free(k);
+      goto err1;
+    }
+
+    qsort(fresh, n, sizeof(statusentry_t), __qbytime);
+    __statusmerge(t, bytime, len, fresh, n, __bytime);
+    qsort(fresh, n, sizeof(statusentry_t), __qbykey);
+    __statusmerge(k, bykey, len, fresh, n, __bykey);
+    free(bytime);
+    free(bykey);
+    bytime = t;
+    bykey = k;
+    len += n;
+
+    // Si no se puede guardar igual se consulta, la próxima vez se rehace
+    __statussaveindex(ipath, bytime, bykey, len, last,
+                      __statuslastcrc(idx->map, last));
+  }
+
+  idx->len = len;
+  if (len && (initarrbtree(&idx->timearena, &idx->timeroot, bytime, len,
+                           sizeof(statusentry_t), __qbytime, 0) ||
+              initarrbtree(&idx->keyarena, &idx->keyroot, bykey, len,
+                           sizeof(statusentry_t), __qbykey, 0)))
+    goto err1;
+
+  ret = EXIT_SUCCESS;
+  free(fresh);
+  free(bytime);
+  free(bykey);
+  return ret;
+
+err1:
+  free(fresh);
+  free(bytime);
+  free(bykey);
+  freebtarena(&idx->timearena);
+  freebtarena(&idx->keyarena);
+  idx->timeroot = idx->keyroot = nullptr;
+err0:
+  if (idx->map)
+    munmap(idx->map, idx->mapped);
+  idx->map = nullptr;
+  close(idx->fd);
+  idx->fd = -1;
+  return ret;
+}
+
+typedef struct {
+  const statusindex_t *idx;
+  const char *key; // Si no es nullptr, la clave completa a comparar
+  size_t keylen;
+  statusfn_t fn;
+  void *arg;
+  size_t found;
+} __statusquery_t;
+
+static int __statusvisit(btreeptr_t node, void *arg) {
+  __statusquery_t *q = (__statusquery_t *)arg;
+  const statusentry_t *e = (const statusentry_t *)node->data;
+  statushead_t head;
+
+  // El índice apunta a un registro que no está entero: se saltea
+  if (0 == __statusvalid(q->idx->map, e->off, q->idx->size))
+    return 0;
+  memcpy(&head, q->idx->map + e->off, sizeof(head));
+  const char *text = q->idx->map + e->off + sizeof(head);
+
+  // La clave del índice puede estar truncada
+  if (q->key && (head.len < q->keylen || memcmp(text, q->key, q->keylen) ||
+                 (head.len > q->keylen && ' ' != text[q->keylen] &&
+                  '\t' != text[q->keylen])))
+    return 0;
+
+  ++q->found;
+  return q->fn(text, head.len, head.time, q->arg);
+}
+
+// Todos los estados cuya primera palabra es key, en orden de tiempo. Si fn
+// retorna distinto de 0 se corta. EXIT_FAILURE_NOT_FOUND si no hubo ninguno
+err_t findstatusindex(const statusindex_t *idx, const char *key, statusfn_t fn,
+                      void *arg) {
+  if (nullptr == idx || nullptr == key || nullptr == fn)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  statusentry_t lo, hi;
+  __statuskey(lo.key, key, strlen(key));
+  memcpy(hi.key, lo.key, STATUS_KEY);
+  lo.time = lo.off = 0;
+  hi.time = hi.off = UINT64_MAX;
+
+  __statusquery_t q = {idx, key, strlen(key), fn, arg, 0};
+  frangebtree(idx->keyroot, &lo, &hi, sizeof(statusentry_t), __statusvisit, &q,
+              __bykey);
+  return q.found ? EXIT_SUCCESS : EXIT_FAILURE_NOT_FOUND;
+}
+
+// Todos los estados con from <= tiempo <= to (ns desde epoch), en orden
+err_t rangestatusindex(const statusindex_t *idx, uint64_t from, uint64_t to,
+                       statusfn_t fn, void *arg) {
+  if (nullptr == idx || nullptr == fn)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  statusentry_t lo = {{0}, from, 0}, hi = {{0}, to, UINT64_MAX};
+  __statusquery_t q = {idx, nullptr, 0, fn, arg, 0};
+  frangebtree(idx->timeroot, &lo, &hi, sizeof(statusentry_t), __statusvisit,
+              &q, __bytime);
+  return q.found ? EXIT_SUCCESS : EXIT_FAILURE_NOT_FOUND;
+}
+
+void closestatusindex(statusindex_t *idx) {
+  if (nullptr == idx || idx->fd < 0)
+    return;
+
+  freebtarena(&idx->timearena);
+  freebtarena(&idx->keyarena);
+  idx->timeroot = idx->keyroot = nullptr;
+  if (idx->map)
+    munmap(idx->map, idx->mapped);
+  close(idx->fd);
+  idx->fd = -1;
+  idx->map = nullptr;
+}
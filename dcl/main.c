@@ -1,17 +1,66 @@
 #include "func.c"
+#include "index.c"
 #include <stdio.h>
+#include <stdlib.h>
 
 #define WTF 2147000000
 
+/*
+ * dcl                     un estado por línea desde la entrada estándar
+ * dcl ESTADO...           cada argumento es un estado
+ * dcl -k CLAVE            los estados cuya primera palabra es CLAVE
+ * dcl -t DESDE HASTA      los estados entre DESDE y HASTA (segundos desde
+ *                         epoch, inclusive)
+ * El registro es DCL_LOG (dcl.log por defecto). Leer compila <registro>.idx.
+ */
+
+static int print_status(const char *text, size_t len, uint64_t time,
+                        void *arg) {
+  (void)arg;
+  printf("%llu.%09llu %.*s\n", (unsigned long long)(time / 1000000000ULL),
+         (unsigned long long)(time % 1000000000ULL), (int)len, text);
+  return 0;
+}
+
+static int read_status(int argc, char *argv[]) {
+  const char *path = getenv("DCL_LOG");
+  statusindex_t idx;
+  err_t ret;
+
+  if (nullptr == path)
+    path = "dcl.log";
+  if (openstatusindex(&idx, path)) {
+    fprintf(stderr, "dcl: no se pudo leer %s\n", path);
+    return EXIT_FAILURE;
+  }
+
+  if ('k' == argv[1][1] && 3 == argc)
+    ret = findstatusindex(&idx, argv[2], print_status, nullptr);
+  else if ('t' == argv[1][1] && 4 == argc)
+    ret = rangestatusindex(&idx, strtoull(argv[2], nullptr, 10) * 1000000000ULL,
+                           strtoull(argv[3], nullptr, 10) * 1000000000ULL +
+                               999999999ULL,
+                           print_status, nullptr);
+  else
+    ret = EXIT_FAILURE_IMPROPER_USE;
+
+  closestatusindex(&idx);
+  if (EXIT_FAILURE_IMPROPER_USE == ret)
+    fprintf(stderr, "uso: dcl -k CLAVE | dcl -t DESDE HASTA\n");
+  return ret;
+}
+
 int main(int argc, char *argv[]) {
   if (argc == 1) {
     insert_status();
   } else if (argc < 1) {
     printf("Yo wtf\n");
     return WTF;
+  } else if (0 == strcmp(argv[1], "-k") || 0 == strcmp(argv[1], "-t")) {
+    return read_status(argc, argv);
   } else {
     for (int i = 1; i < argc; ++i)
-      write_status(argv[i]), putchar(10);
+      write_status(argv[i]);
   }
 
   return EXIT_SUCCESS;
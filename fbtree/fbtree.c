@@ -0,0 +1,447 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifndef BTREE_H
+#include "../btree/btree.h"
+#endif
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Árbol congelado (solo lectura):
+ * Para árboles que se arman una vez y después solo se consultan. Las claves
+ * (de tamaño fijo) se copian a un único arreglo en orden de Eytzinger, el
+ * orden por niveles de un árbol completo: los hijos de la posición k están en
+ * 2k y 2k + 1, no hay punteros. La búsqueda baja sin saltos condicionales y
+ * pide por adelantado los nodos de 4 niveles más abajo, que están juntos.
+ *
+ * Se congela desde el recorrido en orden de arrbtree, así que el orden es el
+ * del árbol original: memcmp si se armó con insbtree, el de cmp si se armó
+ * con finsbtree. findfbtree compara con memcmp; las funciones _u64 comparan
+ * como enteros sin signo (árbol armado con un cmp numérico).
+ *
+ * El árbol original no se toca, findbtree sigue sirviendo sobre él.
+ *
+ * ---En disco: writefbtree/writebtree guardan el arreglo tal cual detrás de
+ * una cabecera de 64 bytes, y openfbtree lo mapea con mmap: abrir es leer la
+ * cabecera, sin recorrer ni reservar nada por clave, y cada búsqueda trae
+ * del disco solo las páginas que toca. Los niveles de arriba (los que usan
+ * todas las búsquedas) quedan al principio del archivo, juntos.
+ * ---Listas: writel guarda una lista con el mismo formato, en el orden de la
+ * lista (lo mismo que deja compactl). findfbtree sobre eso busca de a una,
+ * como findl; las funciones _u64 no lo aceptan.
+ *
+ * El formato usa el orden de bytes de la máquina que lo escribió.
+ */
+
+typedef struct fbtree fbtree_t;
+typedef struct fbtree *fbtreeptr_t;
+
+#define FBTREE_EYTZINGER 0
+#define FBTREE_LIST 1
+
+// Cuánto del principio del archivo se pide a la vez al abrirlo
+#ifndef FBTREE_WILLNEED
+#define FBTREE_WILLNEED (1 << 20)
+#endif
+
+struct fbtree {
+  char *keys;  // (len + 1) * size bytes, la posición 0 no se usa
+  size_t size; // Tamaño de cada clave
+  size_t len;
+  int layout;  // FBTREE_EYTZINGER o FBTREE_LIST
+  char *map;   // Si no es nullptr, keys está dentro de este mmap
+  size_t mapbytes;
+};
+
+// Cabecera del archivo, las claves empiezan justo después
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t layout;
+  uint64_t size;
+  uint64_t len;
+  char pad[32];
+} __fbheader_t;
+
+static const char __fbmagic[8] = "FBTREE\0";
+
+// Reparte las claves ordenadas de src en las posiciones del subárbol k
+static size_t __eytzfbtree(fbtreeptr_t snap, void **src, size_t i, size_t k) {
+  if (k > snap->len)
+    return i;
+
+  i = __eytzfbtree(snap, src, i, 2 * k);
+  memcpy(snap->keys + k * snap->size, src[i++], snap->size);
+  return __eytzfbtree(snap, src, i, 2 * k + 1);
+}
+
+// size es el tamaño de cada dato del árbol
+err_t freezebtree(fbtreeptr_t *const snap, btreeptr_t root, const size_t size) {
+  if (nullptr == snap || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  void **src = nullptr;
+  size_t len = 0;
+
+  if (root && EXIT_SUCCESS != arrbtree((void **)&src, root, &len))
+    return EXIT_FAILURE;
+
+  *snap = (fbtreeptr_t)malloc(sizeof(fbtree_t));
+  if (nullptr == *snap)
+    goto err0;
+
+  // Alineado a línea de caché, así un bloque de hermanos no queda partido
+  (*snap)->keys = (char *)aligned_alloc(
+      64, ((len + 1) * size + 63) / 64 * 64);
+  if (nullptr == (*snap)->keys)
+    goto err1;
+
+  (*snap)->size = size;
+  (*snap)->len = len;
+  (*snap)->layout = FBTREE_EYTZINGER;
+  (*snap)->map = nullptr;
+  (*snap)->mapbytes = 0;
+  __eytzfbtree(*snap, src, 0, 1);
+
+  free(src);
+  return EXIT_SUCCESS;
+
+err1:
+  free(*snap);
+  *snap = nullptr;
+err0:
+  free(src);
+  return EXIT_FAILURE;
+}
+
+// Termina de bajar: k queda en la primera clave >= data (0 si no hay)
+#define __fbtree_lower(k) ((k) >> __builtin_ffsll(~(long long)(k)))
+
+// Como findbtree, con memcmp. *ret apunta a la clave dentro de snap
+err_t findfbtree(fbtreeptr_t snap, const void *data, void **const ret) {
+  if (nullptr == snap || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  const size_t size = snap->size;
+  size_t k = 1;
+
+  if (FBTREE_LIST == snap->layout) {
+    for (; k <= snap->len; ++k)
+      if (0 == __builtin_memcmp(snap->keys + k * size, data, size)) {
+        *ret = snap->keys + k * size;
+        return EXIT_SUCCESS;
+      }
+    return EXIT_FAILURE_NOT_FOUND;
+  }
+
+  while (k <= snap->len) {
+    __builtin_prefetch(snap->keys + 16 * k * size);
+    k = 2 * k + (__builtin_memcmp(snap->keys + k * size, data, size) < 0);
+  }
+  k = __fbtree_lower(k);
+
+  if (0 == k || __builtin_memcmp(snap->keys + k * size, data, size))
+    return EXIT_FAILURE_NOT_FOUND;
+
+  *ret = snap->keys + k * size;
+  return EXIT_SUCCESS;
+}
+
+// Igual que findfbtree para claves uint64_t en orden numérico: la
+// comparación es una resta y un shift, sin llamadas ni saltos
+err_t findfbtree_u64(fbtreeptr_t snap, const uint64_t data,
+                     void **const ret) {
+  if (nullptr == snap || sizeof(uint64_t) != snap->size ||
+      FBTREE_EYTZINGER != snap->layout)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  const uint64_t *keys = (const uint64_t *)snap->keys;
+  size_t k = 1;
+
+  while (k <= snap->len) {
+    __builtin_prefetch(keys + 16 * k);
+    k = 2 * k + (keys[k] < data);
+  }
+  k = __fbtree_lower(k);
+
+  if (0 == k || keys[k] != data)
+    return EXIT_FAILURE_NOT_FOUND;
+
+  *ret = (void *)(keys + k);
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Lote de búsquedas _u64: ret[i] es la clave encontrada o nullptr.
+ * Con AVX2 (-mavx2) baja 4 claves a la vez con gather y comparación
+ * vectorial por todos los niveles completos, el último nivel (incompleto)
+ * y las claves que sobran se hacen de a una.
+ */
+err_t mfindfbtree_u64(fbtreeptr_t snap, const uint64_t *data,
+                      const size_t nmemb, void **ret) {
+  if (nullptr == snap || nullptr == data || nullptr == ret ||
+      sizeof(uint64_t) != snap->size || FBTREE_EYTZINGER != snap->layout)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t all = EXIT_SUCCESS;
+  size_t i = 0;
+
+#ifdef __AVX2__
+  const uint64_t *keys = (const uint64_t *)snap->keys;
+  size_t j, k;
+
+  // Niveles completos: con k en ellos nunca se pasa de len
+  unsigned full = 0;
+  while (((size_t)2 << full) - 1 <= snap->len)
+    ++full;
+
+  // cmpgt_epi64 compara con signo: se invierte el bit alto de ambos lados
+  const __m256i flip = _mm256_set1_epi64x((long long)(1ULL << 63));
+  const __m256i one = _mm256_set1_epi64x(1);
+  uint64_t lanes[4];
+
+  for (; i + 4 <= nmemb; i += 4) {
+    __m256i x = _mm256_xor_si256(
+        _mm256_loadu_si256((const __m256i *)(data + i)), flip);
+    __m256i kv = one, y;
+
+    for (unsigned l = 0; l < full; ++l) {
+      y = _mm256_xor_si256(
+          _mm256_i64gather_epi64((const long long *)keys, kv, 8), flip);
+      // k = 2k + (keys[k] < x), la máscara vale -1 donde es verdad
+      kv = _mm256_sub_epi64(_mm256_add_epi64(kv, kv),
+                            _mm256_cmpgt_epi64(x, y));
+    }
+    _mm256_storeu_si256((__m256i *)lanes, kv);
+
+    for (j = 0; j < 4; ++j) {
+      k = lanes[j];
+      while (k <= snap->len)
+        k = 2 * k + (keys[k] < data[i + j]);
+      k = __fbtree_lower(k);
+      ret[i + j] = (0 != k && keys[k] == data[i + j]) ? (void *)(keys + k)
+                                                      : nullptr;
+      if (nullptr == ret[i + j])
+        all = EXIT_FAILURE_NOT_FOUND;
+    }
+  }
+#endif
+
+  for (; i < nmemb; ++i)
+    if (EXIT_SUCCESS != findfbtree_u64(snap, data[i], ret + i)) {
+      ret[i] = nullptr;
+      all = EXIT_FAILURE_NOT_FOUND;
+    }
+
+  return all;
+}
+
+// Cabecera y la posición 0 (vacía). nullptr si no se pudo
+static FILE *__fbcreate(const char *path, const size_t size, const size_t len,
+                        const int layout) {
+  FILE *file = fopen(path, "wb");
+  if (nullptr == file)
+    return nullptr;
+
+  __fbheader_t head;
+  memset(&head, 0, sizeof(head));
+  memcpy(head.magic, __fbmagic, sizeof(head.magic));
+  head.version = 1;
+  head.layout = layout;
+  head.size = size;
+  head.len = len;
+
+  if (1 != fwrite(&head, sizeof(head), 1, file))
+    goto err;
+  for (size_t i = 0; i < size; ++i)
+    if (EOF == fputc(0, file))
+      goto err;
+  return file;
+
+err:
+  fclose(file);
+  remove(path);
+  return nullptr;
+}
+
+// Cierra el archivo ya escrito completo en disco. Si algo falló lo borra
+static err_t __fbclose(FILE *file, const char *path, int ok) {
+  ok = ok && 0 == fflush(file) && 0 == fsync(fileno(file));
+  ok = 0 == fclose(file) && ok;
+  if (ok)
+    return EXIT_SUCCESS;
+  remove(path);
+  return EXIT_FAILURE;
+}
+
+// Guarda snap en path, para abrirlo después con openfbtree
+err_t writefbtree(fbtreeptr_t snap, const char *path) {
+  if (nullptr == snap || nullptr == path)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  FILE *file = __fbcreate(path, snap->size, snap->len, snap->layout);
+  if (nullptr == file)
+    return EXIT_FAILURE;
+
+  return __fbclose(file, path,
+                   snap->len == fwrite(snap->keys + snap->size, snap->size,
+                                       snap->len, file));
+}
+
+// Como __eytzfbtree, pero solo anota qué clave ordenada va en cada posición
+static size_t __eytzorder(size_t *order, const size_t len, size_t i,
+                          const size_t k) {
+  if (k > len)
+    return i;
+
+  i = __eytzorder(order, len, i, 2 * k);
+  order[k] = i++;
+  return __eytzorder(order, len, i, 2 * k + 1);
+}
+
+/*
+ * Como freezebtree + writefbtree, sin armar la copia de las claves en
+ * memoria (solo un índice por clave): sirve para árboles del tamaño de la
+ * RAM.
+ */
+err_t writebtree(btreeptr_t root, const size_t size, const char *path) {
+  if (nullptr == path || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  void **src = nullptr;
+  size_t *order = nullptr, len = 0, k;
+  FILE *file;
+  err_t ret = EXIT_FAILURE;
+
+  if (root && EXIT_SUCCESS != arrbtree((void **)&src, root, &len))
+    return EXIT_FAILURE;
+
+  order = (size_t *)malloc((len + 1) * sizeof(size_t));
+  if (nullptr == order)
+    goto end;
+  __eytzorder(order, len, 0, 1);
+
+  file = __fbcreate(path, size, len, FBTREE_EYTZINGER);
+  if (nullptr == file)
+    goto end;
+
+  for (k = 1; k <= len; ++k)
+    if (1 != fwrite(src[order[k]], size, 1, file))
+      break;
+  ret = __fbclose(file, path, k > len);
+
+end:
+  free(order);
+  free(src);
+  return ret;
+}
+
+// Guarda la lista en orden, igual que la dejaría compactl
+err_t writel(listptr_t root, const size_t size, const char *path) {
+  if (nullptr == path || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  size_t len = 0;
+  for (listptr_t node = root; node; next(node))
+    ++len;
+
+  FILE *file = __fbcreate(path, size, len, FBTREE_LIST);
+  if (nullptr == file)
+    return EXIT_FAILURE;
+
+  for (; root; next(root))
+    if (1 != fwrite(root->data, size, 1, file))
+      break;
+  return __fbclose(file, path, nullptr == root);
+}
+
+/*
+ * Abre un archivo de writefbtree, writebtree o writel sin leer las claves:
+ * quedan mapeadas (solo lectura) y el sistema las trae al tocarlas. Se pide
+ * de antemano el principio del archivo, donde están los niveles de arriba.
+ * EXIT_FAILURE_IMPROPER_USE si el archivo no tiene este formato.
+ */
+err_t openfbtree(fbtreeptr_t *const snap, const char *path) {
+  if (nullptr == snap || nullptr == path)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  struct stat st;
+  const __fbheader_t *head;
+  size_t bytes;
+  char *map;
+  err_t ret = EXIT_FAILURE;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return EXIT_FAILURE;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(__fbheader_t))
+    goto err0;
+
+  bytes = st.st_size;
+  map = (char *)mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (MAP_FAILED == map)
+    goto err0;
+
+  // Tiene que entrar la posición 0 y las len claves
+  head = (const __fbheader_t *)map;
+  ret = EXIT_FAILURE_IMPROPER_USE;
+  if (memcmp(head->magic, __fbmagic, sizeof(head->magic)) ||
+      1 != head->version || head->layout > FBTREE_LIST || 0 == head->size ||
+      (bytes - sizeof(__fbheader_t)) / head->size <= head->len)
+    goto err1;
+
+  ret = EXIT_FAILURE;
+  *snap = (fbtreeptr_t)malloc(sizeof(fbtree_t));
+  if (nullptr == *snap)
+    goto err1;
+
+  (*snap)->keys = map + sizeof(__fbheader_t);
+  (*snap)->size = head->size;
+  (*snap)->len = head->len;
+  (*snap)->layout = head->layout;
+  (*snap)->map = map;
+  (*snap)->mapbytes = bytes;
+
+  if (FBTREE_LIST == head->layout)
+    madvise(map, bytes, MADV_SEQUENTIAL);
+  else {
+    madvise(map, bytes, MADV_RANDOM);
+    madvise(map, bytes < FBTREE_WILLNEED ? bytes : FBTREE_WILLNEED,
+            MADV_WILLNEED);
+  }
+
+  close(fd);
+  return EXIT_SUCCESS;
+
+err1:
+  munmap(map, bytes);
+err0:
+  close(fd);
+  return ret;
+}
+
+// Como freebtree, si snap es nullptr no hace nada
+void freefbtree(fbtreeptr_t *snap) {
+  if (nullptr == snap || nullptr == *snap)
+    return;
+
+  if ((*snap)->map)
+    munmap((*snap)->map, (*snap)->mapbytes);
+  else
+    free((*snap)->keys);
+  free(*snap);
+  *snap = nullptr;
+}
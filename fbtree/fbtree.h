@@ -0,0 +1,26 @@
+#include "fbtree.c"
+
+#define FBTREE_H
+
+// Read-only snapshot of a tree, keys inline in Eytzinger (BFS) order
+err_t freezebtree(fbtreeptr_t *const snap, btreeptr_t root, const size_t size);
+
+// Branchless, prefetching lookup in memcmp order
+err_t findfbtree(fbtreeptr_t snap, const void *data, void **const ret);
+
+// uint64_t keys in numeric order. The batch version uses AVX2 if available
+err_t findfbtree_u64(fbtreeptr_t snap, const uint64_t data, void **const ret);
+err_t mfindfbtree_u64(fbtreeptr_t snap, const uint64_t *data,
+                      const size_t nmemb, void **ret);
+
+// On-disk snapshots. open maps the file read-only without parsing it; the
+// keys returned by the finds point into the mapping and must not be written
+err_t writefbtree(fbtreeptr_t snap, const char *path);
+err_t writebtree(btreeptr_t root, const size_t size, const char *path);
+err_t openfbtree(fbtreeptr_t *const snap, const char *path);
+
+// List dump in list order (like compactl). findfbtree scans it linearly
+err_t writel(listptr_t root, const size_t size, const char *path);
+
+// Also unmaps opened snapshots
+void freefbtree(fbtreeptr_t *snap);
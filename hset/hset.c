@@ -0,0 +1,229 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef LIST_H
+#include "../list/list.h"
+#endif
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Conjunto hash de claves de tamaño fijo, direccionamiento abierto con
+ * sondeo lineal. Las claves se guardan en el mismo arreglo (no un malloc por
+ * clave) y al lado de cada una su hash, así casi nunca se llama a memcmp con
+ * una clave que no es.
+ *
+ * Sirve para que nrpushl deje de ser O(n) por elemento: ver hnrpushl(...).
+ */
+
+typedef struct hset hset_t;
+typedef struct hset *hsetptr_t;
+
+struct hset {
+  uint64_t *hashes; // 0 indica lugar libre
+  char *keys;       // cap * size bytes
+  size_t size;      // Tamaño de cada clave
+  size_t cap;       // Siempre potencia de 2
+  size_t len;
+};
+
+#ifndef HSET_MIN_CAP
+#define HSET_MIN_CAP 16
+#endif
+
+// Mezcla de 8 en 8 bytes (splitmix64). Nunca retorna 0
+static inline uint64_t __hsethash(const void *data, size_t size) {
+  const char *p = (const char *)data;
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ size, w;
+
+  for (; size >= 8; size -= 8, p += 8) {
+    memcpy(&w, p, 8);
+    h = (h ^ w) * 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 31;
+  }
+  if (size) {
+    w = 0;
+    memcpy(&w, p, size);
+    h = (h ^ w) * 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 31;
+  }
+
+  h ^= h >> 30;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h | 1;
+}
+
+// Solo toca set si las dos reservas salieron bien
+static inline err_t __allochset(hsetptr_t set, const size_t cap) {
+  uint64_t *hashes = (uint64_t *)calloc(cap, sizeof(uint64_t));
+  if (nullptr == hashes)
+    return EXIT_FAILURE;
+
+  char *keys = (char *)malloc(cap * set->size);
+  if (nullptr == keys) {
+    free(hashes);
+    return EXIT_FAILURE;
+  }
+
+  set->hashes = hashes;
+  set->keys = keys;
+  set->cap = cap;
+  return EXIT_SUCCESS;
+}
+
+// hint es la cantidad de claves esperada, puede ser 0
+err_t inithset(hsetptr_t *const set, const size_t size, const size_t hint) {
+  if (nullptr == set || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *set = (hsetptr_t)malloc(sizeof(hset_t));
+  if (nullptr == *set)
+    return EXIT_FAILURE;
+
+  size_t cap = HSET_MIN_CAP;
+  while (cap / 4 * 3 < hint)
+    cap *= 2;
+
+  (*set)->size = size;
+  (*set)->len = 0;
+  if (EXIT_SUCCESS != __allochset(*set, cap)) {
+    free(*set);
+    *set = nullptr;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Lugar de data (si está) o el lugar libre donde iría
+static inline size_t __hsetslot(hsetptr_t set, const void *data,
+                                const uint64_t hash) {
+  size_t i = hash & (set->cap - 1);
+
+  while (set->hashes[i]) {
+    if (hash == set->hashes[i] &&
+        !memcmp(set->keys + i * set->size, data, set->size))
+      return i;
+    i = (i + 1) & (set->cap - 1);
+  }
+
+  return i;
+}
+
+// Duplica la tabla, los hashes guardados evitan recalcularlos. La nueva se
+// arma aparte: si no hay memoria set queda como estaba
+static err_t __growhset(hsetptr_t set) {
+  hset_t grown = *set;
+  size_t i, j;
+
+  if (EXIT_SUCCESS != __allochset(&grown, set->cap * 2))
+    return EXIT_FAILURE;
+
+  for (i = 0; i < set->cap; ++i) {
+    if (!set->hashes[i])
+      continue;
+    j = set->hashes[i] & (grown.cap - 1);
+    while (grown.hashes[j])
+      j = (j + 1) & (grown.cap - 1);
+    grown.hashes[j] = set->hashes[i];
+    memcpy(grown.keys + j * set->size, set->keys + i * set->size, set->size);
+  }
+
+  free(set->hashes);
+  free(set->keys);
+  *set = grown;
+  return EXIT_SUCCESS;
+}
+
+// Se mantiene a lo sumo 3/4 lleno: deja lugar para una clave más
+static inline err_t __reservehset(hsetptr_t set) {
+  if (set->len + 1 > set->cap / 4 * 3)
+    return __growhset(set);
+  return EXIT_SUCCESS;
+}
+
+// Inserta si no estaba. EXIT_SUCCESS_REPEATED si ya estaba, como nrpushl
+err_t inshset(hsetptr_t set, const void *data) {
+  if (nullptr == set || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  const uint64_t hash = __hsethash(data, set->size);
+  size_t i = __hsetslot(set, data, hash);
+  if (set->hashes[i])
+    return EXIT_SUCCESS_REPEATED;
+
+  const size_t cap = set->cap;
+  if (EXIT_SUCCESS != __reservehset(set))
+    return EXIT_FAILURE;
+  if (cap != set->cap)
+    i = __hsetslot(set, data, hash);
+
+  set->hashes[i] = hash;
+  memcpy(set->keys + i * set->size, data, set->size);
+  ++set->len;
+  return EXIT_SUCCESS;
+}
+
+// Guarda en *ret la copia de data dentro del conjunto, si está
+err_t findhset(hsetptr_t set, const void *data, void **const ret) {
+  if (nullptr == set || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  size_t i = __hsetslot(set, data, __hsethash(data, set->size));
+  if (!set->hashes[i])
+    return EXIT_FAILURE_NOT_FOUND;
+
+  if (ret)
+    *ret = set->keys + i * set->size;
+  return EXIT_SUCCESS;
+}
+
+// Como freel, si set es nullptr no hace nada
+void freehset(hsetptr_t *set) {
+  if (nullptr == set || nullptr == *set)
+    return;
+
+  free((*set)->hashes);
+  free((*set)->keys);
+  free(*set);
+  *set = nullptr;
+}
+
+/*
+ * nrpushl en O(1): el conjunto dice si data ya estaba y, si no, se agrega
+ * al final de la lista, que sigue guardando el orden de inserción.
+ * *tail es el último nodo (como final_node en initarrl), se actualiza solo.
+ * Si *root es nullptr se crea la lista. El tamaño es el del conjunto.
+ *
+ * La lista y el conjunto tienen que haberse llenado siempre juntos. Primero
+ * se hace lugar en el conjunto, después se agrega a la lista y recién ahí
+ * al conjunto (que ya no puede fallar): si falta memoria no queda una clave
+ * en uno solo de los dos.
+ */
+err_t hnrpushl(hsetptr_t set, listptr_t *const root, listptr_t *const tail,
+               const void *data) {
+  if (nullptr == set || nullptr == root || nullptr == tail || nullptr == data)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (EXIT_SUCCESS == findhset(set, data, nullptr))
+    return EXIT_SUCCESS_REPEATED;
+  if (EXIT_SUCCESS != __reservehset(set))
+    return EXIT_FAILURE;
+
+  if (nullptr == *root) {
+    if (EXIT_SUCCESS != initl(root, data, set->size))
+      return EXIT_FAILURE;
+    *tail = *root;
+  } else {
+    if (EXIT_SUCCESS != pushl(*tail, data, set->size))
+      return EXIT_FAILURE;
+    *tail = (*tail)->next;
+  }
+
+  return inshset(set, data);
+}
@@ -0,0 +1,14 @@
+#include "hset.c"
+
+#define HSET_H
+
+// Hash set of fixed-size keys (open addressing)
+err_t inithset(hsetptr_t *const set, const size_t size, const size_t hint);
+err_t inshset(hsetptr_t set, const void *data);
+err_t findhset(hsetptr_t set, const void *data, void **const ret);
+void freehset(hsetptr_t *set);
+
+// O(1) nrpushl: appends to the list only if set did not have data yet.
+// EXIT_SUCCESS_REPEATED otherwise
+err_t hnrpushl(hsetptr_t set, listptr_t *const root, listptr_t *const tail,
+               const void *data);
@@ -1,4 +1,12 @@
+#ifndef DEFS_H
 #include "../defs/defs.h"
+#endif
+
+#ifndef STATS_H
+#include "../stats/stats.h"
+#endif
+
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,17 +27,21 @@ err_t initl(listptr_t *const root, const void *init_data, const size_t size) {
   *root = (listptr_t)malloc(sizeof(list_t));
   if (nullptr == *root)
     goto err0;
+  STAT_ALLOC(STATS_LIST, sizeof(list_t));
 
   (*root)->data = malloc(size);
   if (nullptr == (*root)->data)
     goto err1;
+  STAT_ALLOC(STATS_LIST, size);
 
   memcpy((*root)->data, init_data, size);
+  (*root)->next = nullptr;
 
   return EXIT_SUCCESS;
 
 err1:
   free(*root);
+  *root = nullptr; // Que el que llama no quede con un puntero colgado
 err0:
   return EXIT_FAILURE;
 }
@@ -48,12 +60,15 @@ err_t pushl(listptr_t const where, const void *data, const size_t size) {
 
   if (nullptr == aux)
     goto err0;
+  STAT_ALLOC(STATS_LIST, sizeof(list_t));
 
   aux->data = malloc(size);
   if (nullptr == aux->data)
     goto err1;
+  STAT_ALLOC(STATS_LIST, size);
 
   memcpy(aux->data, data, size);
+  aux->next = nullptr;
 
   where->next = aux;
   return EXIT_SUCCESS;
@@ -70,13 +85,16 @@ err_t nrpushl(listptr_t *const _node, const void *data, const size_t size) {
   if (nullptr == _node || nullptr == data || 0 == size)
     return EXIT_FAILURE_IMPROPER_USE;
 
-  if (nullptr == *_node)
-    initl(_node, data, size);
+  STAT_SCOPE(STATS_LIST_PUSH);
+  if (nullptr == *_node && initl(_node, data, size))
+    return EXIT_FAILURE;
 
   listptr_t node = *_node;
   while (1) {
     if (nullptr == node->data)
       return EXIT_FAILURE_IMPROPER_USE;
+    STAT_VISIT();
+    STAT_COMPARE();
     if (!__builtin_memcmp(data, node->data, size))
       return EXIT_SUCCESS_REPEATED;
     if (nullptr == node->next) {
@@ -122,7 +140,10 @@ err_t freel(listptr_t *node) {
 err_t findl(listptr_t node, const void *target, const size_t size,
             listptr_t *const ret) {
 
+  STAT_SCOPE(STATS_LIST_FIND);
   while (node && node->data) {
+    STAT_VISIT();
+    STAT_COMPARE();
     if (!memcmp(node->data, target, size)) {
       *ret = node;
       return EXIT_SUCCESS;
@@ -140,7 +161,10 @@ err_t findl(listptr_t node, const void *target, const size_t size,
 err_t ffindl(listptr_t node, const void *target, listptr_t *const ret,
              int (*cmp)(const void *, const void *)) {
 
+  STAT_SCOPE(STATS_LIST_FIND);
   while (node && node->data) {
+    STAT_VISIT();
+    STAT_COMPARE();
     if (!cmp(node->data, target)) {
       *ret = node;
       return EXIT_SUCCESS;
@@ -155,14 +179,11 @@ err_t ffindl(listptr_t node, const void *target, listptr_t *const ret,
 // to an unknown fixed size array
 // dst should be allocated before calling compactl
 err_t compactl(listptr_t node, void *dst, const size_t size) {
-  int z = 0;
   while (node && node->data) {
-    ++z;
     memcpy(dst, node->data, size);
     node = node->next;
     dst = (char *)dst + size;
   }
-  printf("SIZE OF LIST: %d\n", z);
   return EXIT_SUCCESS;
 }
 
@@ -190,3 +211,293 @@ err_t initarrl(listptr_t *const root, listptr_t *const final_node,
 
   return EXIT_SUCCESS;
 }
+
+/*
+ * Lista con cabecera:
+ * listh_t guarda el primer nodo, el último y la cantidad, así agregar al
+ * final y saber el tamaño son O(1), y compactlh sabe cuánta memoria pedir.
+ * Los nodos son los de siempre: head sirve con findl, ffindl, freel, etc.
+ * (mientras no se le agreguen nodos por fuera de las funciones *lh, o la
+ * cuenta y el último nodo quedan viejos).
+ *
+ * listh_t es del que llama (puede estar en el stack), no se reserva.
+ */
+typedef struct listh listh_t;
+
+struct listh {
+  listptr_t head, tail;
+  size_t len;
+};
+
+// root es una lista ya armada para adoptar (se recorre una vez), o nullptr
+err_t initlh(listh_t *const h, listptr_t root) {
+  if (nullptr == h)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  h->head = root;
+  h->tail = root;
+  h->len = 0;
+  for (; root; root = root->next) {
+    h->tail = root;
+    ++h->len;
+  }
+  return EXIT_SUCCESS;
+}
+
+size_t sizelh(const listh_t *h) { return h ? h->len : 0; }
+
+// Agrega al final, O(1)
+err_t pushlh(listh_t *const h, const void *data, const size_t size) {
+  if (nullptr == h || nullptr == data || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  if (nullptr == h->tail) {
+    if (initl(&h->head, data, size))
+      return EXIT_FAILURE;
+    h->tail = h->head;
+  } else {
+    if (pushl(h->tail, data, size))
+      return EXIT_FAILURE;
+    h->tail = h->tail->next;
+  }
+  ++h->len;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Como initarrl, pero agrega al final de h las nmemb entradas de arr. Se
+ * arma la cadena aparte y se engancha al final: si falta memoria h queda
+ * como estaba.
+ */
+err_t arrpushlh(listh_t *const h, const void *arr, const size_t nmemb,
+                const size_t size) {
+  if (nullptr == h || (nmemb && nullptr == arr) || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+  if (0 == nmemb)
+    return EXIT_SUCCESS;
+
+  listptr_t first, last;
+  if (initarrl(&first, &last, (void *)arr, nmemb, size))
+    return EXIT_FAILURE;
+
+  if (h->tail)
+    h->tail->next = first;
+  else
+    h->head = first;
+  h->tail = last;
+  h->len += nmemb;
+  return EXIT_SUCCESS;
+}
+
+// Copia los datos a un arreglo de exactamente sizelh(h) * size bytes, que
+// queda en *dst (nullptr si la lista está vacía). Se libera con free
+err_t compactlh(const listh_t *h, void **const dst, const size_t size) {
+  if (nullptr == h || nullptr == dst || 0 == size)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *dst = nullptr;
+  if (0 == h->len)
+    return EXIT_SUCCESS;
+
+  *dst = malloc(h->len * size);
+  if (nullptr == *dst)
+    return EXIT_FAILURE;
+  return compactl(h->head, *dst, size);
+}
+
+// Libera todos los nodos y deja h vacía, lista para usar de nuevo
+err_t freelh(listh_t *const h) {
+  if (nullptr == h)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  freel(&h->head);
+  h->tail = nullptr;
+  h->len = 0;
+  return EXIT_SUCCESS;
+}
+
+/*
+ * Orden:
+ * Merge sort que solo reengancha nodos, los data no se copian ni se mueven.
+ * Es estable (los iguales quedan en el orden en que estaban) y usa el mismo
+ * comparador que ffindl, que recibe los data: negativo, 0 o positivo.
+ *
+ * sortl va armando tramos ordenados de 1, 2, 4, ... nodos en bins[i] (de
+ * 2^i nodos) y los junta como un contador binario: O(n log n), sin
+ * recursión y sin memoria extra fuera de los 64 punteros.
+ * psortl corta la lista en tantos pedazos como hilos, ordena cada uno en su
+ * hilo y después los junta de a pares, también en paralelo.
+ */
+#ifndef LIST_MAX_THREADS
+#define LIST_MAX_THREADS 64
+#endif
+
+// Con menos nodos por hilo no vale la pena crear hilos
+#ifndef LIST_PSORT_MIN
+#define LIST_PSORT_MIN 4096
+#endif
+
+// Junta a y b (ordenadas) en una sola. Ante iguales va primero el de a
+static listptr_t __mergel(listptr_t a, listptr_t b,
+                          int (*cmp)(const void *, const void *)) {
+  listptr_t head = nullptr, *link = &head;
+
+  while (a && b) {
+    if (cmp(b->data, a->data) < 0) {
+      *link = b;
+      b = b->next;
+    } else {
+      *link = a;
+      a = a->next;
+    }
+    link = &((*link)->next);
+  }
+  *link = a ? a : b;
+  return head;
+}
+
+static listptr_t __sortl(listptr_t node,
+                         int (*cmp)(const void *, const void *)) {
+  listptr_t bins[64] = {nullptr}, carry, result = nullptr;
+  int i, top = 0;
+
+  while (node) {
+    carry = node;
+    node = node->next;
+    carry->next = nullptr;
+
+    // Los bins más altos tienen los nodos de más adelante en la lista
+    for (i = 0; bins[i]; ++i) {
+      carry = __mergel(bins[i], carry, cmp);
+      bins[i] = nullptr;
+    }
+    bins[i] = carry;
+    if (i >= top)
+      top = i + 1;
+  }
+
+  for (i = 0; i < top; ++i)
+    if (bins[i])
+      result = __mergel(bins[i], result, cmp);
+  return result;
+}
+
+// Junta dos listas ordenadas en *dst, O(n + m). a y b dejan de ser válidas
+// como listas separadas (sus nodos pasan a *dst)
+err_t mergel(listptr_t *const dst, listptr_t a, listptr_t b,
+             int (*cmp)(const void *, const void *)) {
+  if (nullptr == dst || nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *dst = __mergel(a, b, cmp);
+  return EXIT_SUCCESS;
+}
+
+// Ordena *root en el lugar, estable, O(n log n)
+err_t sortl(listptr_t *const root, int (*cmp)(const void *, const void *)) {
+  if (nullptr == root || nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  *root = __sortl(*root, cmp);
+  return EXIT_SUCCESS;
+}
+
+typedef struct {
+  listptr_t a, b; // Si b es nullptr solo se ordena a
+  int (*cmp)(const void *, const void *);
+} __psortl_t;
+
+static void *__psortl(void *arg) {
+  __psortl_t *task = (__psortl_t *)arg;
+
+  if (task->b)
+    task->a = __mergel(task->a, task->b, task->cmp);
+  else
+    task->a = __sortl(task->a, task->cmp);
+  return nullptr;
+}
+
+// Corre tasks[0..n) con un hilo por tarea, la primera en el que llama. Las
+// que no consiguen hilo también
+static void __psortl_run(__psortl_t *tasks, unsigned n) {
+  pthread_t tid[LIST_MAX_THREADS];
+  int spawned[LIST_MAX_THREADS] = {0};
+  unsigned i;
+
+  for (i = 1; i < n; ++i)
+    spawned[i] = !pthread_create(tid + i, nullptr, __psortl, tasks + i);
+  __psortl(tasks);
+  for (i = 1; i < n; ++i) {
+    if (spawned[i])
+      pthread_join(tid[i], nullptr);
+    else
+      __psortl(tasks + i);
+  }
+}
+
+// sortl en paralelo con threads hilos (contando al que llama)
+err_t psortl(listptr_t *const root, int (*cmp)(const void *, const void *),
+             unsigned threads) {
+  if (nullptr == root || nullptr == cmp)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  size_t len = 0, chunk, i;
+  listptr_t node;
+  for (node = *root; node; node = node->next)
+    ++len;
+
+  if (threads > LIST_MAX_THREADS)
+    threads = LIST_MAX_THREADS;
+  if (threads > len / LIST_PSORT_MIN)
+    threads = len / LIST_PSORT_MIN;
+  if (threads <= 1)
+    return sortl(root, cmp);
+
+  // Pedazos de igual largo, en orden: juntarlos de a pares sigue siendo
+  // estable
+  __psortl_t tasks[LIST_MAX_THREADS];
+  unsigned n = threads, k;
+  chunk = len / threads;
+  node = *root;
+  for (k = 0; k < n; ++k) {
+    tasks[k].a = node;
+    tasks[k].b = nullptr;
+    tasks[k].cmp = cmp;
+    if (k + 1 == n)
+      break;
+    for (i = 1; i < chunk; ++i)
+      node = node->next;
+    listptr_t aux = node->next;
+    node->next = nullptr;
+    node = aux;
+  }
+  __psortl_run(tasks, n);
+
+  while (n > 1) {
+    for (k = 0; k < n / 2; ++k) {
+      tasks[k].a = tasks[2 * k].a;
+      tasks[k].b = tasks[2 * k + 1].a;
+    }
+    // Si sobra uno pasa tal cual a la próxima vuelta (no se corre)
+    if (n % 2)
+      tasks[k].a = tasks[n - 1].a;
+    __psortl_run(tasks, n / 2);
+    n = (n + 1) / 2;
+  }
+
+  *root = tasks[0].a;
+  return EXIT_SUCCESS;
+}
+
+// sortl/psortl sobre una lista con cabecera, deja tail al día
+err_t sortlh(listh_t *const h, int (*cmp)(const void *, const void *),
+             unsigned threads) {
+  if (nullptr == h)
+    return EXIT_FAILURE_IMPROPER_USE;
+
+  err_t ret = psortl(&h->head, cmp, threads);
+  if (EXIT_SUCCESS == ret)
+    for (h->tail = h->head; h->tail && h->tail->next; h->tail = h->tail->next)
+      ;
+  return ret;
+}
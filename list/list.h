@@ -20,3 +20,25 @@ err_t compactl(listptr_t node, void *dst, const size_t size);
 err_t initarrl(listptr_t *const root, listptr_t *const final_node,
                void *init_data, size_t nmemb, const size_t size);
 err_t nrpushl(listptr_t *const node, const void *data, const size_t size);
+
+// List handle: head, tail and length, O(1) append and size
+err_t initlh(listh_t *const h, listptr_t root);
+size_t sizelh(const listh_t *h);
+err_t pushlh(listh_t *const h, const void *data, const size_t size);
+err_t arrpushlh(listh_t *const h, const void *arr, const size_t nmemb,
+                const size_t size);
+// Allocates exactly sizelh(h) * size bytes into *dst
+err_t compactlh(const listh_t *h, void **const dst, const size_t size);
+err_t freelh(listh_t *const h);
+
+// Stable in-place merge sort (relinks nodes, data is not copied). cmp is the
+// ffindl comparator. psortl/sortlh use up to threads threads
+err_t sortl(listptr_t *const root, int (*cmp)(const void *, const void *));
+err_t psortl(listptr_t *const root, int (*cmp)(const void *, const void *),
+             unsigned threads);
+err_t sortlh(listh_t *const h, int (*cmp)(const void *, const void *),
+             unsigned threads);
+
+// Merge two sorted lists into *dst in linear time
+err_t mergel(listptr_t *const dst, listptr_t a, listptr_t b,
+             int (*cmp)(const void *, const void *));
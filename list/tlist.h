@@ -0,0 +1,65 @@
+/*
+ * Versiones de la lista especializadas por tipo, igual que btree/tbtree.h:
+ *
+ *   LIST_DEFINE_TYPE(S, T, CMP)
+ *
+ * genera findl_S, nrpushl_S y compactl_S para datos de tipo T, con CMP(a, b)
+ * en línea (0 es 'igual') y copias de tamaño fijo. Ya vienen u64 e i64.
+ */
+
+#ifndef LIST_H
+#include "list.h"
+#endif
+
+#include <stdint.h>
+
+#define TLIST_H
+
+#ifndef BTREE_NUMCMP
+#define BTREE_NUMCMP(a, b) (((a) > (b)) - ((a) < (b)))
+#endif
+
+#define LIST_DEFINE_TYPE(S, T, CMP)                                            \
+  static inline err_t findl_##S(listptr_t node, const T target,                \
+                                listptr_t *const ret) {                        \
+    while (node && node->data) {                                               \
+      if (0 == CMP(*(const T *)node->data, target)) {                          \
+        *ret = node;                                                           \
+        return EXIT_SUCCESS;                                                   \
+      }                                                                        \
+      node = node->next;                                                       \
+    }                                                                          \
+                                                                               \
+    return EXIT_FAILURE;                                                       \
+  }                                                                            \
+                                                                               \
+  static inline err_t nrpushl_##S(listptr_t *const _node, const T data) {      \
+    if (nullptr == _node)                                                      \
+      return EXIT_FAILURE_IMPROPER_USE;                                        \
+                                                                               \
+    if (nullptr == *_node)                                                     \
+      return initl(_node, &data, sizeof(T));                                   \
+                                                                               \
+    listptr_t node = *_node;                                                   \
+    while (1) {                                                                \
+      if (nullptr == node->data)                                               \
+        return EXIT_FAILURE_IMPROPER_USE;                                      \
+      if (0 == CMP(*(const T *)node->data, data))                              \
+        return EXIT_SUCCESS_REPEATED;                                          \
+      if (nullptr == node->next)                                               \
+        return pushl(node, &data, sizeof(T));                                  \
+      node = node->next;                                                       \
+    }                                                                          \
+  }                                                                            \
+                                                                               \
+  static inline err_t compactl_##S(listptr_t node, T *dst, size_t *len) {      \
+    size_t z = 0;                                                              \
+    for (; node && node->data; node = node->next)                              \
+      dst[z++] = *(const T *)node->data;                                       \
+    if (len)                                                                   \
+      *len = z;                                                                \
+    return EXIT_SUCCESS;                                                       \
+  }
+
+LIST_DEFINE_TYPE(u64, uint64_t, BTREE_NUMCMP)
+LIST_DEFINE_TYPE(i64, int64_t, BTREE_NUMCMP)
@@ -1,32 +1,428 @@
-#include "btree/btree.c"
+/*
+ * Banco de pruebas con cargas reproducibles sobre list/ y btree/.
+ *
+ * Cargas (claves de -w bytes, en orden de memcmp = orden numérico):
+ *   seq     0, 1, 2, ...
+ *   random  xorshift64
+ *   zipf    rangos con distribución de Zipf (theta 0.99, como YCSB),
+ *           mezclados para que las claves calientes no queden juntas
+ *   nearly  ordenadas, con ~1% de intercambios entre vecinos cercanos
+ *
+ * Por cada carga mide insbtree, findbtree, arrbtree, frehashbtree,
+ * finsbtree, nrpushl, findl y compactl. Imprime una línea JSON por
+ * operación: ns/op, percentiles, cantidad y bytes de malloc/calloc/realloc
+ * hechos por la operación, y el pico de RSS del proceso hasta ese momento.
+ * Las operaciones que recorren toda la estructura (arrbtree, frehashbtree,
+ * compactl) se repiten -r veces y cada repetición es una op. Solo el JSON
+ * sale por stdout: lo que impriman list/ o btree/ va a stderr.
+ *
+ * seq y nearly degeneran el árbol en una lista: insbtree/findbtree son
+ * O(n) por op ahí, conviene un -n chico.
+ *
+ * Compilar: cc -O2 prueba.c -o prueba -pthread -lm
+ * Uso:      ./prueba [-W seq|random|zipf|nearly|all] [-n claves]
+ *                    [-l claves de lista] [-w ancho] [-r repeticiones]
+ *                    [-s semilla]
+ */
+
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
 
-int menu(void);
-int main(void) { return menu(); }
-
-int menu(void) {
-  printf("**MENU DE PRUEBA**\n");
-  printf("Opciones:\n");
-  printf("1. Create a list\n");
-  printf("2. Create a binary tree\n");
-  printf("3. Rehash binary tree\n");
-  printf("4. Insert an element to a binary tree\n");
-  printf("5. Insert an element to a list\n");
-
-  int op;
-
-  // List of lists
-  listptr_t listslist = nullptr;
-  while (1) {
-    printf("> ");
-    if (1 != scanf(" %d", &op)) {
-      printf("Improper input");
-      return EXIT_FAILURE;
+// Cuenta las reservas de memoria de list/ y btree/: como se incluyen los .c,
+// basta con redefinir las funciones antes
+static size_t __allocs = 0, __allocbytes = 0;
+
+static inline void *__bmalloc(size_t size) {
+  ++__allocs;
+  __allocbytes += size;
+  return malloc(size);
+}
+
+static inline void *__bcalloc(size_t nmemb, size_t size) {
+  ++__allocs;
+  __allocbytes += nmemb * size;
+  return calloc(nmemb, size);
+}
+
+static inline void *__brealloc(void *ptr, size_t size) {
+  ++__allocs;
+  __allocbytes += size;
+  return realloc(ptr, size);
+}
+
+static inline void *__baligned_alloc(size_t align, size_t size) {
+  ++__allocs;
+  __allocbytes += size;
+  return aligned_alloc(align, size);
+}
+
+#define malloc(size) __bmalloc(size)
+#define calloc(nmemb, size) __bcalloc(nmemb, size)
+#define realloc(ptr, size) __brealloc(ptr, size)
+#define aligned_alloc(align, size) __baligned_alloc(align, size)
+
+#include "btree/btree.h"
+
+// Desde acá las reservas del propio banco no se cuentan
+#undef malloc
+#undef calloc
+#undef realloc
+#undef aligned_alloc
+
+// Solo para las líneas JSON (ver main)
+static FILE *__json;
+
+#define WORKLOAD_SEQ 0
+#define WORKLOAD_RANDOM 1
+#define WORKLOAD_ZIPF 2
+#define WORKLOAD_NEARLY 3
+
+static const char *const __workloads[] = {"seq", "random", "zipf", "nearly"};
+
+typedef struct {
+  int workload;
+  size_t n, listn, width, reps;
+  uint64_t seed;
+} bench_t;
+
+// Lo que se mide de una operación
+typedef struct {
+  const char *op;
+  double *lat; // ns de cada op
+  size_t ops, elems, allocs, allocbytes;
+} result_t;
+
+static size_t __width; // Para el comparador de frehashbtree
+
+static inline uint64_t xorshift(uint64_t *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static inline uint64_t splitmix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static inline double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static long cmpkey(const void *a, const void *b, size_t size) {
+  return memcmp(a, b, size);
+}
+
+static int rehashkey(const void *a, const void *b) {
+  return memcmp(a, b, __width);
+}
+
+static int cmplat(const void *a, const void *b) {
+  return (*(const double *)a > *(const double *)b) -
+         (*(const double *)a < *(const double *)b);
+}
+
+/*
+ * Escribe v en la clave de manera que memcmp ordene como los números: los
+ * bytes bajos de v en big endian al principio (todos si width >= 8), el
+ * resto se rellena a partir de v.
+ */
+static void __key(char *key, const size_t width, const uint64_t v) {
+  const size_t head = width < 8 ? width : 8;
+  uint64_t fill = splitmix(v);
+
+  for (size_t i = 0; i < head; ++i)
+    key[i] = (char)(v >> (8 * (head - 1 - i)));
+  for (size_t i = head; i < width; ++i, fill >>= 8) {
+    if (0 == (i - head) % 8)
+      fill = splitmix(fill + i);
+    key[i] = (char)fill;
+  }
+}
+
+// Generador de Zipf de Gray et al. (el de YCSB), rangos en [0, n)
+typedef struct {
+  size_t n;
+  double theta, alpha, zetan, eta;
+} zipf_t;
+
+static void __initzipf(zipf_t *z, const size_t n, const double theta) {
+  double zeta2 = 1 + pow(0.5, theta);
+
+  z->n = n;
+  z->theta = theta;
+  z->alpha = 1 / (1 - theta);
+  z->zetan = 0;
+  for (size_t i = 1; i <= n; ++i)
+    z->zetan += pow((double)i, -theta);
+  // Con n < 3 zetan <= zeta2 y eta sería 0/0 o x/0; ahí __zipf ya retorna
+  // siempre 0 o 1 antes de usarla
+  z->eta = n < 3 ? 0 : (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / z->zetan);
+}
+
+static size_t __zipf(zipf_t *z, uint64_t *state) {
+  double u = (xorshift(state) >> 11) * 0x1.0p-53, uz = u * z->zetan;
+
+  if (uz < 1 || z->n < 2)
+    return 0;
+  if (uz < 1 + pow(0.5, z->theta) || z->n < 3)
+    return 1;
+  size_t r = (size_t)(z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+  return r < z->n ? r : z->n - 1;
+}
+
+/*
+ * Llena keys con n claves de la carga y probes con n búsquedas sobre ellas
+ * (en el mismo orden para seq y nearly, al azar para random, con la misma
+ * distribución para zipf).
+ */
+static err_t __genkeys(const bench_t *b, const size_t n, char *keys,
+                       char *probes) {
+  uint64_t state = b->seed | 1, *v = (uint64_t *)malloc(n * sizeof(uint64_t));
+  size_t i, j;
+  zipf_t z;
+
+  if (nullptr == v)
+    return EXIT_FAILURE;
+  if (WORKLOAD_ZIPF == b->workload)
+    __initzipf(&z, n, 0.99);
+
+  for (i = 0; i < n; ++i) {
+    switch (b->workload) {
+    case WORKLOAD_RANDOM:
+      v[i] = xorshift(&state);
+      break;
+    case WORKLOAD_ZIPF:
+      // Multiplicar por un impar es una biyección: no hay choques
+      v[i] = __zipf(&z, &state) * 0x9e3779b97f4a7c15ULL;
+      break;
+    default:
+      v[i] = i;
+    }
+  }
+
+  if (WORKLOAD_NEARLY == b->workload)
+    for (i = 0; i < n / 100; ++i) {
+      j = xorshift(&state) % n;
+      size_t k = j + 1 + xorshift(&state) % 16;
+      if (k < n) {
+        uint64_t aux = v[j];
+        v[j] = v[k];
+        v[k] = aux;
+      }
     }
 
-    switch (op) {}
+  for (i = 0; i < n; ++i)
+    __key(keys + i * b->width, b->width, v[i]);
+
+  for (i = 0; i < n; ++i) {
+    switch (b->workload) {
+    case WORKLOAD_RANDOM:
+      j = xorshift(&state) % n;
+      break;
+    case WORKLOAD_ZIPF:
+      // Las claves calientes de las búsquedas también son las de rango bajo
+      __key(probes + i * b->width, b->width,
+            __zipf(&z, &state) * 0x9e3779b97f4a7c15ULL);
+      continue;
+    default:
+      j = i;
+    }
+    memcpy(probes + i * b->width, keys + j * b->width, b->width);
   }
 
+  free(v);
   return EXIT_SUCCESS;
 }
+
+static inline void __begin(result_t *r, const char *op, double *lat,
+                           const size_t elems) {
+  r->op = op;
+  r->lat = lat;
+  r->ops = 0;
+  r->elems = elems;
+  r->allocs = __allocs;
+  r->allocbytes = __allocbytes;
+}
+
+static void __report(const bench_t *b, result_t *r) {
+  struct rusage ru;
+  double total = 0;
+
+  r->allocs = __allocs - r->allocs;
+  r->allocbytes = __allocbytes - r->allocbytes;
+  getrusage(RUSAGE_SELF, &ru);
+
+  for (size_t i = 0; i < r->ops; ++i)
+    total += r->lat[i];
+  qsort(r->lat, r->ops, sizeof(double), cmplat);
+
+#define __pct(p) (r->ops ? r->lat[(size_t)((p) * (r->ops - 1))] : 0)
+  fprintf(__json, "{\"workload\":\"%s\",\"op\":\"%s\",\"n\":%zu,\"width\":%zu,"
+         "\"ops\":%zu,\"elems\":%zu,\"ns_per_op\":%.1f,\"p50\":%.0f,"
+         "\"p90\":%.0f,\"p99\":%.0f,\"p999\":%.0f,\"max\":%.0f,"
+         "\"allocs\":%zu,\"alloc_bytes\":%zu,\"peak_rss_kb\":%ld}\n",
+         __workloads[b->workload], r->op, b->n, b->width, r->ops, r->elems,
+         r->ops ? total / r->ops : 0, __pct(0.5), __pct(0.9), __pct(0.99),
+         __pct(0.999), __pct(1.0), r->allocs, r->allocbytes, ru.ru_maxrss);
+#undef __pct
+  fflush(__json);
+}
+
+// Cada op medida por separado: lat[r.ops++] = lo que tardó expr
+#define TIMED(r, expr)                                                         \
+  do {                                                                         \
+    double __t = now();                                                        \
+    expr;                                                                      \
+    (r).lat[(r).ops++] = now() - __t;                                          \
+  } while (0)
+
+static err_t run(const bench_t *b) {
+  const size_t n = b->n, listn = b->listn, width = b->width;
+  const size_t most = n > listn ? n : listn;
+  char *keys = (char *)malloc(n * width), *probes = (char *)malloc(n * width);
+  char *lkeys = (char *)malloc(listn * width);
+  char *lprobes = (char *)malloc(listn * width);
+  double *lat = (double *)malloc((most > b->reps ? most : b->reps) *
+                                 sizeof(double));
+  err_t ret = EXIT_FAILURE;
+  btreeptr_t root = nullptr, found;
+  listptr_t list = nullptr, lfound;
+  void *dst;
+  size_t len;
+  result_t r;
+
+  if (nullptr == keys || nullptr == probes || nullptr == lkeys ||
+      nullptr == lprobes || nullptr == lat ||
+      __genkeys(b, n, keys, probes) || __genkeys(b, listn, lkeys, lprobes))
+    goto end;
+  __width = width;
+
+  __begin(&r, "insbtree", lat, n);
+  for (size_t i = 0; i < n; ++i)
+    TIMED(r, insbtree(&root, keys + i * width, width));
+  __report(b, &r);
+
+  __begin(&r, "findbtree", lat, n);
+  for (size_t i = 0; i < n; ++i)
+    TIMED(r, findbtree(root, probes + i * width, width, &found));
+  __report(b, &r);
+
+  __begin(&r, "arrbtree", lat, n);
+  for (size_t i = 0; i < b->reps; ++i) {
+    dst = nullptr;
+    TIMED(r, arrbtree(&dst, root, &len));
+    free(dst);
+  }
+  __report(b, &r);
+
+  __begin(&r, "frehashbtree", lat, n);
+  for (size_t i = 0; i < b->reps; ++i)
+    TIMED(r, frehashbtree(&root, rehashkey));
+  __report(b, &r);
+  freebtree(&root);
+
+  __begin(&r, "finsbtree", lat, n);
+  for (size_t i = 0; i < n; ++i)
+    TIMED(r, finsbtree(&root, keys + i * width, width, cmpkey));
+  __report(b, &r);
+  freebtree(&root);
+
+  __begin(&r, "nrpushl", lat, listn);
+  for (size_t i = 0; i < listn; ++i)
+    TIMED(r, nrpushl(&list, lkeys + i * width, width));
+  __report(b, &r);
+
+  __begin(&r, "findl", lat, listn);
+  for (size_t i = 0; i < listn; ++i)
+    TIMED(r, findl(list, lprobes + i * width, width, &lfound));
+  __report(b, &r);
+
+  __begin(&r, "compactl", lat, listn);
+  for (size_t i = 0; i < b->reps; ++i)
+    TIMED(r, compactl(list, lkeys, width));
+  __report(b, &r);
+
+  ret = EXIT_SUCCESS;
+
+end:
+  freel(&list);
+  freebtree(&root);
+  free(keys);
+  free(probes);
+  free(lkeys);
+  free(lprobes);
+  free(lat);
+  return ret;
+}
+
+int main(int argc, char *argv[]) {
+  bench_t b = {WORKLOAD_RANDOM, 20000, 2000, 8, 5, 88172645463325252ULL};
+  int all = 1, opt;
+
+  while (-1 != (opt = getopt(argc, argv, "W:n:l:w:r:s:"))) {
+    switch (opt) {
+    case 'W':
+      all = 0 == strcmp(optarg, "all");
+      for (b.workload = 0; !all && b.workload < 4; ++b.workload)
+        if (0 == strcmp(optarg, __workloads[b.workload]))
+          break;
+      if (!all && 4 == b.workload)
+        goto usage;
+      break;
+    case 'n':
+      b.n = strtoul(optarg, nullptr, 10);
+      break;
+    case 'l':
+      b.listn = strtoul(optarg, nullptr, 10);
+      break;
+    case 'w':
+      b.width = strtoul(optarg, nullptr, 10);
+      break;
+    case 'r':
+      b.reps = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      b.seed = strtoull(optarg, nullptr, 10);
+      break;
+    default:
+      goto usage;
+    }
+  }
+  if (0 == b.n || 0 == b.listn || 0 == b.width || 0 == b.reps)
+    goto usage;
+
+  // El JSON va por una copia de stdout y stdout pasa a ser stderr
+  int fd = dup(STDOUT_FILENO);
+  if (fd < 0 || nullptr == (__json = fdopen(fd, "w")) ||
+      dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+    return EXIT_FAILURE;
+
+  for (int w = 0; w < 4; ++w) {
+    if (all)
+      b.workload = w;
+    if (run(&b))
+      return EXIT_FAILURE;
+    if (!all)
+      break;
+  }
+  return EXIT_SUCCESS;
+
+usage:
+  fprintf(stderr,
+          "Uso: %s [-W seq|random|zipf|nearly|all] [-n claves] "
+          "[-l claves de lista] [-w ancho] [-r repeticiones] [-s semilla]\n",
+          argv[0]);
+  return EXIT_FAILURE_IMPROPER_USE;
+}
@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Contadores de list/ y btree/:
+ * Solo existen si se compila con -DBTREE_STATS; si no, las macros STAT_*
+ * no generan nada. Con -DBTREE_STATS_LATENCY además se arma un histograma
+ * de latencias por operación (dos lecturas del reloj por llamada).
+ *
+ * Cada hilo suma en su propio bloque (sin locks ni instrucciones atómicas
+ * caras), getstats suma los bloques de todos los hilos. Los bloques quedan
+ * aunque el hilo termine, así los totales no pierden nada.
+ *
+ * Las funciones medidas declaran STAT_SCOPE(op) al principio: las visitas y
+ * comparaciones se cuentan en variables locales y se suman al bloque una
+ * sola vez, al salir de la función por cualquier return.
+ */
+
+#ifdef BTREE_STATS_LATENCY
+#ifndef BTREE_STATS
+#define BTREE_STATS
+#endif
+#endif
+
+// Operaciones medidas
+#define STATS_BTREE_INSERT 0
+#define STATS_BTREE_FIND 1
+#define STATS_LIST_PUSH 2
+#define STATS_LIST_FIND 3
+#define STATS_OPS 4
+
+// Quién reservó memoria
+#define STATS_BTREE 0
+#define STATS_LIST 1
+
+// El balde i cuenta las llamadas que tardaron [2^i, 2^(i + 1)) ns
+#define STATS_BUCKETS 48
+
+typedef struct stats stats_t;
+
+struct stats {
+  size_t calls[STATS_OPS];
+  size_t compares[STATS_OPS];
+  size_t visits[STATS_OPS]; // Nodos por los que pasó
+  size_t allocs[2];
+  size_t allocbytes[2];
+  size_t latency[STATS_OPS][STATS_BUCKETS];
+  stats_t *next; // Lista de bloques de todos los hilos
+};
+
+static stats_t *__stats_all = nullptr;
+static _Thread_local stats_t *__stats_local = nullptr;
+
+// El bloque del hilo, lo crea la primera vez. nullptr si no hay memoria
+static stats_t *__stats_block(void) {
+  if (__stats_local)
+    return __stats_local;
+
+  stats_t *block = (stats_t *)calloc(1, sizeof(stats_t));
+  if (nullptr == block)
+    return nullptr;
+
+  block->next = __atomic_load_n(&__stats_all, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&__stats_all, &block->next, block, 1,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+  return __stats_local = block;
+}
+
+// Solo escribe el dueño: load + store relajados son un add común
+#define __stats_bump(field, n)                                                 \
+  __atomic_store_n(&(field), __atomic_load_n(&(field), __ATOMIC_RELAXED) + (n),\
+                   __ATOMIC_RELAXED)
+
+typedef struct {
+  int op;
+  size_t compares, visits;
+#ifdef BTREE_STATS_LATENCY
+  struct timespec start;
+#endif
+} __stats_scope_t;
+
+static inline void __stats_flush(__stats_scope_t *scope) {
+  stats_t *block = __stats_block();
+  if (nullptr == block)
+    return;
+
+  __stats_bump(block->calls[scope->op], 1);
+  __stats_bump(block->compares[scope->op], scope->compares);
+  __stats_bump(block->visits[scope->op], scope->visits);
+
+#ifdef BTREE_STATS_LATENCY
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  unsigned long long ns = (end.tv_sec - scope->start.tv_sec) * 1000000000ULL +
+                          end.tv_nsec - scope->start.tv_nsec;
+  unsigned bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+  if (bucket >= STATS_BUCKETS)
+    bucket = STATS_BUCKETS - 1;
+  __stats_bump(block->latency[scope->op][bucket], 1);
+#endif
+}
+
+static inline void __stats_alloc(int who, size_t bytes) {
+  stats_t *block = __stats_block();
+  if (nullptr == block)
+    return;
+  __stats_bump(block->allocs[who], 1);
+  __stats_bump(block->allocbytes[who], bytes);
+}
+
+#ifdef BTREE_STATS
+#ifdef BTREE_STATS_LATENCY
+#define __STAT_START(scope) clock_gettime(CLOCK_MONOTONIC, &(scope).start)
+#else
+#define __STAT_START(scope) ((void)0)
+#endif
+#define STAT_SCOPE(which)                                                      \
+  __stats_scope_t __stats_scope __attribute__((cleanup(__stats_flush))) = {    \
+      .op = (which)};                                                          \
+  __STAT_START(__stats_scope)
+#define STAT_COMPARE() (++__stats_scope.compares)
+#define STAT_VISIT() (++__stats_scope.visits)
+#define STAT_ALLOC(who, bytes) __stats_alloc((who), (bytes))
+#else
+#define STAT_SCOPE(which)
+#define STAT_COMPARE() ((void)0)
+#define STAT_VISIT() ((void)0)
+#define STAT_ALLOC(who, bytes) ((void)0)
+#endif
+
+// Suma de todos los hilos hasta ahora. Sin -DBTREE_STATS queda en 0
+void getstats(stats_t *out) {
+  if (nullptr == out)
+    return;
+
+  memset(out, 0, sizeof(stats_t));
+  size_t *sum = (size_t *)out;
+  const size_t fields = offsetof(stats_t, next) / sizeof(size_t);
+
+  for (stats_t *block = __atomic_load_n(&__stats_all, __ATOMIC_ACQUIRE); block;
+       block = block->next)
+    for (size_t i = 0; i < fields; ++i)
+      sum[i] += __atomic_load_n((size_t *)block + i, __ATOMIC_RELAXED);
+  out->next = nullptr;
+}
+
+// Pone todo en 0. Lo que otros hilos sumen mientras tanto puede perderse
+void resetstats(void) {
+  const size_t fields = offsetof(stats_t, next) / sizeof(size_t);
+
+  for (stats_t *block = __atomic_load_n(&__stats_all, __ATOMIC_ACQUIRE); block;
+       block = block->next)
+    for (size_t i = 0; i < fields; ++i)
+      __atomic_store_n((size_t *)block + i, 0, __ATOMIC_RELAXED);
+}
+
+// Percentil p (0 a 1) de la latencia de op en ns, por el borde de arriba del
+// balde. 0 si no hay datos
+size_t pctstats(const stats_t *stats, const int op, const double p) {
+  if (nullptr == stats || op < 0 || op >= STATS_OPS)
+    return 0;
+
+  size_t total = 0, seen = 0;
+  for (int i = 0; i < STATS_BUCKETS; ++i)
+    total += stats->latency[op][i];
+  if (0 == total)
+    return 0;
+
+  for (int i = 0; i < STATS_BUCKETS; ++i) {
+    seen += stats->latency[op][i];
+    if (seen >= p * total && seen)
+      return (size_t)2 << i;
+  }
+  return (size_t)2 << (STATS_BUCKETS - 1);
+}
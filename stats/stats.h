@@ -0,0 +1,11 @@
+#include "stats.c"
+
+#define STATS_H
+
+// Counters of list/ and btree/, only collected with -DBTREE_STATS
+// (-DBTREE_STATS_LATENCY adds latency histograms). Sum over all threads
+void getstats(stats_t *out);
+void resetstats(void);
+
+// Latency percentile of an operation (STATS_BTREE_FIND, ...) in ns
+size_t pctstats(const stats_t *stats, const int op, const double p);
@@ -0,0 +1,191 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DEFS_H
+#include "../defs/defs.h"
+#endif
+
+/*
+ * Lista "desenrollada": cada nodo guarda un bloque de elementos del mismo
+ * tamaño dentro del mismo nodo, en lugar de un puntero a un único dato.
+ * Un malloc cada ULIST_BYTES bytes de datos y no dos por elemento, y los
+ * recorridos leen memoria contigua.
+ *
+ * Todos los nodos de una misma lista deben tener el mismo size.
+ */
+
+// Bytes de datos por nodo (aprox.), si el elemento es más grande entra uno
+#ifndef ULIST_BYTES
+#define ULIST_BYTES 512
+#endif
+
+typedef struct ulist ulist_t;
+typedef struct ulist *ulistptr_t;
+
+struct ulist {
+  ulistptr_t next;
+  size_t size;  // Tamaño de cada elemento
+  size_t count; // Elementos ocupados
+  size_t cap;   // Elementos que entran
+  _Alignas(max_align_t) char data[];
+};
+
+static inline ulistptr_t __newul(const size_t size) {
+  size_t cap = ULIST_BYTES / size;
+  if (0 == cap)
+    cap = 1;
+
+  ulistptr_t node = (ulistptr_t)malloc(sizeof(ulist_t) + cap * size);
+  if (nullptr == node)
+    return nullptr;
+
+  node->next = nullptr;
+  node->size = size;
+  node->count = 0;
+  node->cap = cap;
+  return node;
+}
+
+// Igual que initl: guarda en *root un nodo con init_data como primer elemento
+err_t initul(ulistptr_t *const root, const void *init_data, const size_t size) {
+  if (nullptr == root || nullptr == init_data || 0 == size)
+    return EXIT_FAILURE;
+
+  *root = __newul(size);
+  if (nullptr == *root)
+    return EXIT_FAILURE;
+
+  memcpy((*root)->data, init_data, size);
+  (*root)->count = 1;
+
+  return EXIT_SUCCESS;
+}
+
+// Agrega data al final del bloque *where. Si no hay lugar, crea un nodo
+// nuevo justo después de *where (sin perder el *next que hubiera) y deja
+// *where apuntando al nodo nuevo, así que para ir agregando al final basta
+// con pasar siempre el mismo puntero.
+err_t pushul(ulistptr_t *const where, const void *data, const size_t size) {
+  if (nullptr == where || nullptr == *where || nullptr == data ||
+      size != (*where)->size)
+    return EXIT_FAILURE;
+
+  ulistptr_t node = *where;
+  if (node->count == node->cap) {
+    ulistptr_t aux = __newul(size);
+    if (nullptr == aux)
+      return EXIT_FAILURE;
+    aux->next = node->next;
+    node->next = aux;
+    *where = node = aux;
+  }
+
+  memcpy(node->data + node->count++ * size, data, size);
+  return EXIT_SUCCESS;
+}
+
+// Igual que freel
+err_t freeul(ulistptr_t *node) {
+  if (nullptr == node)
+    return EXIT_FAILURE;
+
+  ulistptr_t aux1 = *node;
+  *node = nullptr;
+
+  ulistptr_t aux2;
+  while (aux1) {
+    aux2 = aux1->next;
+    free(aux1);
+    aux1 = aux2;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+// Busca target desde node con memcmp, guarda en *ret la dirección del
+// elemento dentro del bloque. Si no lo encuentra deja *ret sin cambios.
+err_t findul(ulistptr_t node, const void *target, void **const ret) {
+  while (node) {
+    const size_t size = node->size;
+    char *elem = node->data, *end = node->data + node->count * size;
+    for (; elem != end; elem += size)
+      if (!memcmp(elem, target, size)) {
+        *ret = elem;
+        return EXIT_SUCCESS;
+      }
+    node = node->next;
+  }
+
+  return EXIT_FAILURE;
+}
+
+// Igual que findul, pero con función de comparación. '0' es 'igual'
+err_t ffindul(ulistptr_t node, const void *target, void **const ret,
+              int (*cmp)(const void *, const void *)) {
+  while (node) {
+    const size_t size = node->size;
+    char *elem = node->data, *end = node->data + node->count * size;
+    for (; elem != end; elem += size)
+      if (!cmp(elem, target)) {
+        *ret = elem;
+        return EXIT_SUCCESS;
+      }
+    node = node->next;
+  }
+
+  return EXIT_FAILURE;
+}
+
+// Copia la lista desde node a dst, un memcpy por bloque.
+// dst tiene que tener lugar para todos los elementos.
+// Si len no es nullptr guarda ahí la cantidad de elementos copiados.
+err_t compactul(ulistptr_t node, void *dst, size_t *const len) {
+  size_t z = 0;
+  while (node) {
+    memcpy(dst, node->data, node->count * node->size);
+    dst = (char *)dst + node->count * node->size;
+    z += node->count;
+    node = node->next;
+  }
+
+  if (len)
+    *len = z;
+  return EXIT_SUCCESS;
+}
+
+// Igual que initarrl, llenando cada bloque con un solo memcpy.
+// Si final_node es nullptr lo ignora.
+err_t initarrul(ulistptr_t *const root, ulistptr_t *const final_node,
+                const void *init_data, size_t nmemb, const size_t size) {
+  if (nullptr == root || nullptr == init_data || 0 == nmemb || 0 == size)
+    return EXIT_FAILURE;
+
+  ulistptr_t node = nullptr, aux;
+  *root = nullptr;
+
+  while (nmemb) {
+    aux = __newul(size);
+    if (nullptr == aux) {
+      freeul(root);
+      return EXIT_FAILURE;
+    }
+
+    aux->count = nmemb < aux->cap ? nmemb : aux->cap;
+    memcpy(aux->data, init_data, aux->count * size);
+    init_data = (const char *)init_data + aux->count * size;
+    nmemb -= aux->count;
+
+    if (node)
+      node->next = aux;
+    else
+      *root = aux;
+    node = aux;
+  }
+
+  if (final_node)
+    *final_node = node;
+
+  return EXIT_SUCCESS;
+}
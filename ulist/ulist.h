@@ -0,0 +1,22 @@
+#include "ulist.c"
+#include <stdlib.h>
+#include <string.h>
+
+#define ULIST_H
+
+// Unrolled list: every node stores a block of fixed-size elements inline
+
+// Basic functions
+err_t initul(ulistptr_t *const root, const void *init_data, const size_t size);
+err_t pushul(ulistptr_t *const where, const void *data, const size_t size);
+err_t freeul(ulistptr_t *node);
+
+// Search functions, *ret is the address of the element inside its block
+err_t findul(ulistptr_t node, const void *target, void **const ret);
+err_t ffindul(ulistptr_t node, const void *target, void **const ret,
+              int (*cmp)(const void *, const void *));
+
+// Array interaction
+err_t compactul(ulistptr_t node, void *dst, size_t *const len);
+err_t initarrul(ulistptr_t *const root, ulistptr_t *const final_node,
+                const void *init_data, size_t nmemb, const size_t size);